@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <numeric>
+#include <string>
+#include <vector>
+
+/* a small benchmark runner: every benchmark runs a number of times, each run timing only the
+ * parts wrapped in `Run::measure`, and the spread of the run times is reported along with the
+ * peak heap use while measuring; the global allocation functions are replaced to track the
+ * heap, so this header goes into a single translation unit
+ */
+
+namespace bench {
+
+inline std::atomic<std::size_t>& allocatedBytes() {
+    static std::atomic<std::size_t> bytes{ 0 };
+    return bytes;
+}
+
+inline std::atomic<std::size_t>& peakBytes() {
+    static std::atomic<std::size_t> bytes{ 0 };
+    return bytes;
+}
+
+// each block is prefixed with its size, padded to keep the alignment malloc gives; gcc can't
+// tell that the blocks handed out by operator new are freed from that prefix
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Warray-bounds"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+constexpr std::size_t header_size = alignof(std::max_align_t);
+
+inline void* allocate(const std::size_t size) {
+    auto* block = static_cast<char*>(std::malloc(size + header_size));
+    if (!block)
+        return nullptr;
+    std::memcpy(block, &size, sizeof(size));
+    const std::size_t now = allocatedBytes().fetch_add(size, std::memory_order_relaxed) + size;
+    auto& peak = peakBytes();
+    std::size_t previous = peak.load(std::memory_order_relaxed);
+    while (now > previous &&
+           !peak.compare_exchange_weak(previous, now, std::memory_order_relaxed)) {
+    }
+    return block + header_size;
+}
+
+inline void deallocate(void* pointer) {
+    if (!pointer)
+        return;
+    auto* block = static_cast<char*>(pointer) - header_size;
+    std::size_t size;
+    std::memcpy(&size, block, sizeof(size));
+    allocatedBytes().fetch_sub(size, std::memory_order_relaxed);
+    std::free(block);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+struct Stats {
+    std::string name;
+    std::size_t runs = 0;
+    std::size_t items = 0;
+    double min = 0;
+    double median = 0;
+    double mean = 0;
+    double max = 0;
+    double stddev = 0;
+    std::size_t peak = 0;
+};
+
+class Run {
+public:
+    // times `f`, adding to the run's time and peak heap use
+    template <class F>
+    void measure(F&& f) {
+        const std::size_t baseline = allocatedBytes().load(std::memory_order_relaxed);
+        peakBytes().store(baseline, std::memory_order_relaxed);
+        const auto started = std::chrono::steady_clock::now();
+        f();
+        const auto elapsed = std::chrono::steady_clock::now() - started;
+        ms += std::chrono::duration<double, std::milli>(elapsed).count();
+        peak = std::max(peak, peakBytes().load(std::memory_order_relaxed) - baseline);
+    }
+
+    // number of operations measured per run, e.g. tiles looked up, to report latencies per item
+    void items(const std::size_t n) {
+        count = n;
+    }
+
+private:
+    friend class Suite;
+    double ms = 0;
+    std::size_t peak = 0;
+    std::size_t count = 0;
+};
+
+/* command line: --runs N (default 5), --filter TEXT to only run benchmarks whose name contains
+ * it, --list to print the names, --json to print the results as JSON on stdout
+ */
+
+class Suite {
+public:
+    Suite(int argc, char** argv) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "--json")
+                json = true;
+            else if (arg == "--list")
+                list = true;
+            else if (arg == "--runs" && i + 1 < argc)
+                runs = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--filter" && i + 1 < argc)
+                filter = argv[++i];
+            else {
+                std::fprintf(stderr, "usage: %s [--runs N] [--filter TEXT] [--list] [--json]\n",
+                             argv[0]);
+                std::exit(1);
+            }
+        }
+        if (!json && !list)
+            std::printf("%-36s %5s %10s %10s %10s %10s %8s %12s %12s\n", "benchmark", "runs",
+                        "min ms", "median ms", "mean ms", "max ms", "stddev", "per item us",
+                        "peak KiB");
+    }
+
+    bool enabled(const std::string& name) const {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    // `benchmark` is called once per run, setting up whatever it needs outside of `measure`
+    void run(const std::string& name, const std::function<void(Run&)>& benchmark) {
+        if (!enabled(name))
+            return;
+        if (list) {
+            std::printf("%s\n", name.c_str());
+            return;
+        }
+
+        std::vector<double> times;
+        Stats stats;
+        stats.name = name;
+        stats.runs = runs;
+        for (std::size_t i = 0; i < runs; ++i) {
+            Run run;
+            benchmark(run);
+            times.push_back(run.ms);
+            stats.items = run.count;
+            stats.peak = std::max(stats.peak, run.peak);
+        }
+
+        std::sort(times.begin(), times.end());
+        stats.min = times.front();
+        stats.max = times.back();
+        const std::size_t middle = times.size() / 2;
+        stats.median = times.size() % 2 ? times[middle] : (times[middle - 1] + times[middle]) / 2;
+        stats.mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+        double variance = 0;
+        for (const double t : times) {
+            variance += (t - stats.mean) * (t - stats.mean);
+        }
+        stats.stddev = std::sqrt(variance / times.size());
+
+        if (!json) {
+            const double perItem = stats.items ? stats.median * 1000 / stats.items : 0;
+            std::printf("%-36s %5zu %10.3f %10.3f %10.3f %10.3f %8.3f %12.3f %12.1f\n",
+                        name.c_str(), stats.runs, stats.min, stats.median, stats.mean, stats.max,
+                        stats.stddev, perItem, stats.peak / 1024.0);
+            std::fflush(stdout);
+        }
+        results.push_back(stats);
+    }
+
+    // prints the JSON results, followed by `extra` fields of the top-level object if any
+    void finish(const std::string& extra = {}) const {
+        if (!json)
+            return;
+        std::printf("{\"benchmarks\":[");
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const auto& s = results[i];
+            std::printf("%s\n{\"name\":\"%s\",\"runs\":%zu,\"items\":%zu,\"min_ms\":%.6f,"
+                        "\"median_ms\":%.6f,\"mean_ms\":%.6f,\"max_ms\":%.6f,\"stddev_ms\":%.6f,"
+                        "\"peak_bytes\":%zu}",
+                        i ? "," : "", s.name.c_str(), s.runs, s.items, s.min, s.median, s.mean,
+                        s.max, s.stddev, s.peak);
+        }
+        std::printf("\n]%s%s}\n", extra.empty() ? "" : ",", extra.c_str());
+    }
+
+    bool jsonOutput() const {
+        return json;
+    }
+
+private:
+    std::size_t runs = 5;
+    std::string filter;
+    bool json = false;
+    bool list = false;
+    std::vector<Stats> results;
+};
+
+} // namespace bench
+
+void* operator new(std::size_t size) {
+    if (void* pointer = bench::allocate(size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return bench::allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return bench::allocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    bench::deallocate(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    bench::deallocate(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    bench::deallocate(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    bench::deallocate(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    bench::deallocate(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    bench::deallocate(pointer);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <mapbox/geometry.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* synthetic data sets, each stressing a different part of the pipeline; they're generated from
+ * a fixed seed, so every run and every machine tiles the same data
+ */
+
+namespace bench {
+
+using mapbox::geometry::feature;
+using mapbox::geometry::feature_collection;
+using mapbox::geometry::line_string;
+using mapbox::geometry::linear_ring;
+using mapbox::geometry::point;
+using mapbox::geometry::polygon;
+
+class Random {
+public:
+    explicit Random(const uint64_t seed) : state(seed) {
+    }
+
+    // uniform in [0, 1)
+    double next() {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (state >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    double uniform(const double min, const double max) {
+        return min + (max - min) * next();
+    }
+
+    // roughly normal, from the sum of uniform numbers
+    double normal(const double mean, const double sigma) {
+        return mean + sigma * (next() + next() + next() + next() - 2) * std::sqrt(3.0);
+    }
+
+private:
+    uint64_t state;
+};
+
+// clusters of points, like addresses or POIs in cities; most tiles get deep drill-downs
+inline feature_collection<double> densePoints(const std::size_t count = 200000) {
+    Random random(1);
+    feature_collection<double> features;
+    features.reserve(count);
+    std::vector<point<double>> centers;
+    for (int i = 0; i < 16; ++i) {
+        centers.push_back({ random.uniform(-120, 120), random.uniform(-60, 60) });
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto& center = centers[i % centers.size()];
+        feature<double> f{ point<double>{ random.normal(center.x, 0.5),
+                                          random.normal(center.y, 0.5) } };
+        f.properties["kind"] = std::string(i % 3 ? "shop" : "address");
+        features.push_back(std::move(f));
+    }
+    return features;
+}
+
+// random walks spanning continents, like GPS traces or pipelines; heavy on simplify and clipLine
+inline feature_collection<double> longLines(const std::size_t lines = 50,
+                                            const std::size_t length = 20000) {
+    Random random(2);
+    feature_collection<double> features;
+    for (std::size_t i = 0; i < lines; ++i) {
+        line_string<double> line;
+        point<double> p{ random.uniform(-150, 150), random.uniform(-60, 60) };
+        double heading = random.uniform(0, 2 * M_PI);
+        for (std::size_t j = 0; j < length; ++j) {
+            line.push_back(p);
+            heading += random.normal(0, 0.2);
+            p.x = std::max(-179.0, std::min(179.0, p.x + 0.01 * std::cos(heading)));
+            p.y = std::max(-80.0, std::min(80.0, p.y + 0.01 * std::sin(heading)));
+        }
+        features.push_back(feature<double>{ std::move(line) });
+    }
+    return features;
+}
+
+// a few polygons with many vertices and holes, like coastlines or country borders; heavy on
+// clipRing and solid tiles at high zooms
+inline feature_collection<double> hugePolygons(const std::size_t polygons = 4,
+                                               const std::size_t vertices = 100000) {
+    Random random(3);
+    feature_collection<double> features;
+    for (std::size_t i = 0; i < polygons; ++i) {
+        const point<double> center{ -120 + 80.0 * i, random.uniform(-30, 30) };
+        polygon<double> rings;
+        for (const double radius : { 30.0, 5.0 }) {
+            linear_ring<double> ring;
+            for (std::size_t j = 0; j < vertices; ++j) {
+                const double angle = 2 * M_PI * j / vertices;
+                const double r =
+                    radius * (1 + 0.1 * std::sin(37 * angle) + random.uniform(0, 0.02));
+                ring.push_back(
+                    { center.x + r * std::cos(angle), center.y + 0.7 * r * std::sin(angle) });
+            }
+            ring.push_back(ring.front());
+            if (!rings.empty())
+                std::reverse(ring.begin(), ring.end());
+            rings.push_back(std::move(ring));
+        }
+        features.push_back(feature<double>{ std::move(rings) });
+    }
+    return features;
+}
+
+// lines and polygons crossing the antimeridian, like Pacific shipping lanes; every feature goes
+// through the world copies made by wrap
+inline feature_collection<double> antimeridian(const std::size_t count = 2000) {
+    Random random(4);
+    feature_collection<double> features;
+    for (std::size_t i = 0; i < count; ++i) {
+        const double x = random.uniform(160, 200);
+        const double y = random.uniform(-60, 60);
+        if (i % 2) {
+            line_string<double> line;
+            for (int j = 0; j < 200; ++j) {
+                line.push_back({ x - 20 + 0.2 * j, y + random.normal(0, 0.05) });
+            }
+            features.push_back(feature<double>{ std::move(line) });
+        } else {
+            linear_ring<double> ring;
+            for (int j = 0; j < 64; ++j) {
+                const double angle = 2 * M_PI * j / 64;
+                ring.push_back({ x + 3 * std::cos(angle), y + 2 * std::sin(angle) });
+            }
+            ring.push_back(ring.front());
+            features.push_back(feature<double>{ polygon<double>{ std::move(ring) } });
+        }
+    }
+    return features;
+}
+
+} // namespace bench
@@ -1,47 +1,385 @@
 #include <mapbox/geojson.hpp>
 #include <mapbox/geojsonvt.hpp>
+#include <mapbox/geojsonvt/points.hpp>
 
+#include "bench.hpp"
+#include "data.hpp"
 #include "util.hpp"
 
-#include <fstream>
-#include <iostream>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <string>
+#include <vector>
 
-int main() {
-    Timer timer;
+using namespace mapbox::geojsonvt;
 
-    const std::string json = loadFile("data/countries.geojson");
-    timer("read file");
+namespace {
 
-    const auto features = mapbox::geojson::parse(json).get<mapbox::geojson::feature_collection>();
-    timer("parse into geometry");
+struct DataSet {
+    std::string name;
+    mapbox::geometry::feature_collection<double> features;
+};
 
-    mapbox::geojsonvt::Options options;
+Options indexOptions() {
+    Options options;
     options.indexMaxZoom = 7;
     options.indexMaxPoints = 200;
+    return options;
+}
+
+double sourceTolerance(const Options& options) {
+    return (options.tolerance / options.extent) / std::pow(2, options.maxZoom);
+}
+
+// the tiles containing a sample of the data's points at zoom `z`, to drill down to
+std::vector<std::pair<uint32_t, uint32_t>> targetTiles(const DataSet& data, const uint8_t z) {
+    std::vector<std::pair<uint32_t, uint32_t>> tiles;
+    const std::size_t step = std::max<std::size_t>(data.features.size() / 64, 1);
+    const double z2 = std::pow(2, z);
+    for (std::size_t i = 0; i < data.features.size(); i += step) {
+        mapbox::geometry::point<double> first;
+        bool found = false;
+        mapbox::geometry::for_each_point(data.features[i].geometry,
+                                         [&](const mapbox::geometry::point<double>& p) {
+                                             if (!found)
+                                                 first = p;
+                                             found = true;
+                                         });
+        if (!found)
+            continue;
+        const auto p = detail::project{ 0 }(first);
+        const double x = p.x - std::floor(p.x);
+        tiles.emplace_back(static_cast<uint32_t>(x * z2),
+                           std::min(static_cast<uint32_t>(p.y * z2), uint32_t(z2 - 1)));
+    }
+    return tiles;
+}
 
-    mapbox::geojsonvt::GeoJSONVT index{ features, options };
+void collect(const detail::vt_point&, std::vector<std::vector<detail::vt_point>>&) {
+}
+void collect(const detail::vt_multi_point&, std::vector<std::vector<detail::vt_point>>&) {
+}
+void collect(const detail::vt_line_string& line,
+             std::vector<std::vector<detail::vt_point>>& result) {
+    if (line.size() > 2)
+        result.push_back(line);
+}
+void collect(const detail::vt_linear_ring& ring,
+             std::vector<std::vector<detail::vt_point>>& result) {
+    if (ring.size() > 2)
+        result.push_back(ring);
+}
+void collect(const detail::vt_geometry& geometry,
+             std::vector<std::vector<detail::vt_point>>& result);
+template <class T>
+void collect(const std::vector<T>& geometries,
+             std::vector<std::vector<detail::vt_point>>& result) {
+    for (const auto& geometry : geometries) {
+        collect(geometry, result);
+    }
+}
+void collect(const detail::vt_geometry& geometry,
+             std::vector<std::vector<detail::vt_point>>& result) {
+    detail::vt_geometry::visit(geometry, [&](const auto& g) { collect(g, result); });
+}
 
-    for (uint32_t i = 0; i < 100; i++) {
-        mapbox::geojsonvt::GeoJSONVT index{ features, options };
+// the lines and rings of the projected features, to simplify again
+std::vector<std::vector<detail::vt_point>> parts(const detail::vt_features& features) {
+    std::vector<std::vector<detail::vt_point>> result;
+    for (const auto& feature : features) {
+        detail::vt_geometry::visit(*feature.geometry, [&](const auto& g) { collect(g, result); });
     }
-    timer("generate tile index 100 times");
+    return result;
+}
 
-    printf("tiles generated: %i {\n", static_cast<int>(index.total));
-    for (const auto& pair : index.stats) {
-        printf("    z%i: %i\n", pair.first, pair.second);
+mapbox::geometry::box<double> bounds(const detail::vt_features& features) {
+    mapbox::geometry::box<double> bbox = { { 2, 1 }, { -1, 0 } };
+    for (const auto& feature : features) {
+        bbox.min.x = std::min(feature.bbox.min.x, bbox.min.x);
+        bbox.min.y = std::min(feature.bbox.min.y, bbox.min.y);
+        bbox.max.x = std::max(feature.bbox.max.x, bbox.max.x);
+        bbox.max.y = std::max(feature.bbox.max.y, bbox.max.y);
     }
-    printf("}\n");
+    return bbox;
+}
+
+void benchmarkStages(bench::Suite& suite, const DataSet& data) {
+    const Options options = indexOptions();
+    const double tolerance = sourceTolerance(options);
+    const double buffer = double(options.buffer) / options.extent;
 
-    const unsigned max_z = 11;
-    std::size_t count = 0;
-    for (unsigned z = 0; z < max_z; ++z) {
-        unsigned num_tiles = std::pow(2, z);
-        for (unsigned x = 0; x < num_tiles; ++x) {
-            for (unsigned y = 0; y < num_tiles; ++y) {
-                auto const& tile = index.getTile(z, x, y);
-                count += tile.features.size();
+    // the setup below is shared, so skip it when none of these is run
+    if (!suite.enabled("convert/" + data.name) && !suite.enabled("wrap/" + data.name) &&
+        !suite.enabled("clip/" + data.name) && !suite.enabled("split/" + data.name) &&
+        !suite.enabled("simplify/" + data.name))
+        return;
+    const auto converted = detail::convert(data.features, tolerance);
+    const auto wrapped = detail::wrap(converted, buffer);
+    const auto bbox = bounds(wrapped);
+
+    suite.run("convert/" + data.name, [&](bench::Run& run) {
+        run.measure([&] { detail::convert(data.features, tolerance); });
+    });
+
+    suite.run("wrap/" + data.name, [&](bench::Run& run) {
+        run.measure([&] { detail::wrap(converted, buffer); });
+    });
+
+    // the first split of the top tile, into its four quadrants
+    suite.run("clip/" + data.name, [&](bench::Run& run) {
+        const double p = buffer / 2;
+        run.measure([&] {
+            for (const int side : { 0, 1 }) {
+                const auto strip = detail::clip<0>(wrapped, 0.5 * side - p, 0.5 * side + 0.5 + p,
+                                                   bbox.min.x, bbox.max.x);
+                detail::clip<1>(strip, -p, 0.5 + p, bbox.min.y, bbox.max.y);
+                detail::clip<1>(strip, 0.5 - p, 1 + p, bbox.min.y, bbox.max.y);
             }
+        });
+    });
+
+    // the same split in one pass, as tiling does it
+    suite.run("split/" + data.name, [&](bench::Run& run) {
+        const double p = buffer / 2;
+        const detail::split_bounds bounds = { { { -p, 0.5 + p }, { 0.5 - p, 1 + p } } };
+        run.measure([&] { detail::splitQuadrants(wrapped, bounds, bounds, bbox); });
+    });
+
+    auto lines = parts(converted);
+    if (!lines.empty()) {
+        suite.run("simplify/" + data.name, [&](bench::Run& run) {
+            run.measure([&] {
+                for (auto& line : lines) {
+                    detail::simplify(line, tolerance);
+                }
+            });
+        });
+    }
+}
+
+void benchmarkIndex(bench::Suite& suite, const DataSet& data) {
+    const Options options = indexOptions();
+
+    suite.run("build/" + data.name, [&](bench::Run& run) {
+        run.measure([&] { GeoJSONVT index{ data.features, options }; });
+    });
+
+    // only the point counts and solid squares of the tiles, until they're requested
+    suite.run("build-lazy/" + data.name, [&](bench::Run& run) {
+        Options lazy = options;
+        lazy.lazyTiles = true;
+        run.measure([&] { GeoJSONVT index{ data.features, lazy }; });
+    });
+
+    // index tiles' source features written out to a file instead of kept in memory
+    suite.run("build-spill/" + data.name, [&](bench::Run& run) {
+        Options spilled = options;
+        spilled.spillPath = "bench-spill.bin";
+        run.measure([&] { GeoJSONVT index{ data.features, spilled }; });
+    });
+
+    // coordinates snapped to the fixed-point grid, with tiles transformed by shifts
+    suite.run("build-fixed/" + data.name, [&](bench::Run& run) {
+        Options fixed = options;
+        fixed.fixedPoint = true;
+        run.measure([&] { GeoJSONVT index{ data.features, fixed }; });
+    });
+
+    // two indexes with different zooms and extents tiling one conversion
+    suite.run("build-2-shared/" + data.name, [&](bench::Run& run) {
+        Options coarse = options;
+        coarse.maxZoom = 10;
+        coarse.extent = 512;
+        run.measure([&] {
+            const FeatureStore store{ data.features, { options, coarse } };
+            GeoJSONVT fine{ store, options };
+            GeoJSONVT other{ store, coarse };
+        });
+    });
+
+    suite.run("build-4-threads/" + data.name, [&](bench::Run& run) {
+        Options threaded = options;
+        threaded.threads = 4;
+        run.measure([&] { GeoJSONVT index{ data.features, threaded }; });
+    });
+
+    // cold lookups drill down from the index, deeper ones clip through more zooms
+    for (const uint8_t z : { 8, 11, 14, 17 }) {
+        const auto targets = targetTiles(data, z);
+        suite.run("getTile-cold-z" + std::to_string(z) + "/" + data.name, [&](bench::Run& run) {
+            GeoJSONVT index{ data.features, options };
+            run.items(targets.size());
+            run.measure([&] {
+                for (const auto& tile : targets) {
+                    index.getTile(z, tile.first, tile.second);
+                }
+            });
+        });
+    }
+
+    const auto targets = targetTiles(data, 14);
+    suite.run("getTile-hot-z14/" + data.name, [&](bench::Run& run) {
+        GeoJSONVT index{ data.features, options };
+        for (const auto& tile : targets) {
+            index.getTile(14, tile.first, tile.second);
+        }
+        run.items(100 * targets.size());
+        run.measure([&] {
+            for (int i = 0; i < 100; ++i) {
+                for (const auto& tile : targets) {
+                    index.getTile(14, tile.first, tile.second);
+                }
+            }
+        });
+    });
+
+    // what a metrics exporter reads, once the tiles it follows are drilled down to
+    suite.run("memoryUsage/" + data.name, [&](bench::Run& run) {
+        GeoJSONVT index{ data.features, options };
+        for (const auto& tile : targets) {
+            index.getTile(14, tile.first, tile.second);
+        }
+        run.items(1000);
+        run.measure([&] {
+            for (int i = 0; i < 1000; ++i) {
+                index.memoryUsage();
+                index.totalMemoryUsage();
+            }
+        });
+    });
+
+    // bursts of four requests per tile, merged into one drill-down per parent tile
+    suite.run("getTileAsync-cold-z14/" + data.name, [&](bench::Run& run) {
+        Options async = options;
+        async.asyncThreads = 4;
+        GeoJSONVT index{ data.features, async };
+        run.items(4 * targets.size());
+        run.measure([&] {
+            std::vector<std::shared_future<const Tile&>> futures;
+            for (int i = 0; i < 4; ++i) {
+                for (const auto& tile : targets) {
+                    futures.push_back(index.getTileAsync(14, tile.first, tile.second));
+                }
+            }
+            for (auto& future : futures) {
+                future.wait();
+            }
+        });
+    });
+
+    // a lazy index with a small cache, drilling down from the top tile's features over and over,
+    // through its spatial index or through all of them
+    for (const bool spatial : { true, false }) {
+        suite.run(std::string(spatial ? "getTile-lazy" : "getTile-lazy-unindexed") + "-z14/" +
+                      data.name,
+                  [&](bench::Run& run) {
+                      Options lazy = options;
+                      lazy.indexMaxZoom = 0;
+                      lazy.maxCachedTiles = 16;
+                      lazy.drillIndexFeatures = spatial ? 1024 : 0;
+                      GeoJSONVT index{ data.features, lazy };
+                      run.items(targets.size());
+                      run.measure([&] {
+                          for (const auto& tile : targets) {
+                              index.getTile(14, tile.first, tile.second);
+                          }
+                      });
+                  });
+    }
+
+    suite.run("getTiles-z0-8/" + data.name, [&](bench::Run& run) {
+        GeoJSONVT index{ data.features, options };
+        std::size_t count = 0;
+        run.measure([&] {
+            index.getTiles(0, 8, { { -180, -85.06 }, { 180, 85.06 } },
+                           [&](uint8_t, uint32_t, uint32_t, const Tile&) { count++; });
+        });
+        run.items(count);
+    });
+}
+
+// the point index against the tile pyramid, for the same lookups
+void benchmarkPoints(bench::Suite& suite, const DataSet& data) {
+    suite.run("point-index-build/" + data.name, [&](bench::Run& run) {
+        run.measure([&] { PointIndex index{ data.features }; });
+    });
+
+    for (const uint8_t z : { 8, 14 }) {
+        const auto targets = targetTiles(data, z);
+        suite.run("point-index-getTile-z" + std::to_string(z) + "/" + data.name,
+                  [&](bench::Run& run) {
+                      PointIndex index{ data.features };
+                      run.items(targets.size());
+                      run.measure([&] {
+                          for (const auto& tile : targets) {
+                              index.getTile(z, tile.first, tile.second);
+                          }
+                      });
+                  });
+    }
+}
+
+// every tile from z0 to z10 with getTile, as a crawler would request them
+void benchmarkScan(bench::Suite& suite, const DataSet& data) {
+    suite.run("getTile-scan-z0-10/" + data.name, [&](bench::Run& run) {
+        GeoJSONVT index{ data.features, indexOptions() };
+        std::size_t count = 0;
+        run.measure([&] {
+            for (uint8_t z = 0; z <= 10; ++z) {
+                const uint32_t z2 = 1u << z;
+                for (uint32_t x = 0; x < z2; ++x) {
+                    for (uint32_t y = 0; y < z2; ++y) {
+                        index.getTile(z, x, y);
+                        count++;
+                    }
+                }
+            }
+        });
+        run.items(count);
+    });
+}
+
+std::string profileJSON() {
+    std::string json = "\"profile\":{";
+    const auto profile = getProfile();
+    for (std::size_t i = 0; i < static_cast<std::size_t>(Counter::count); ++i) {
+        json += (i ? ",\"" : "\"") + std::string(counterName(static_cast<Counter>(i))) +
+                "\":" + std::to_string(profile.values[i]);
+    }
+    return json + "}";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench::Suite suite(argc, argv);
+
+    std::vector<DataSet> data;
+    data.push_back({ "countries", mapbox::geojson::parse(loadFile("data/countries.geojson"))
+                                      .get<mapbox::geojson::feature_collection>() });
+    data.push_back({ "points", bench::densePoints() });
+    data.push_back({ "lines", bench::longLines() });
+    data.push_back({ "polygons", bench::hugePolygons() });
+    data.push_back({ "antimeridian", bench::antimeridian() });
+
+    resetProfile();
+    for (const auto& set : data) {
+        benchmarkStages(suite, set);
+        benchmarkIndex(suite, set);
+    }
+    benchmarkPoints(suite, data[1]);
+    benchmarkScan(suite, data.front());
+
+    // the stage counters, when built with GEOJSONVT_PROFILE
+    suite.finish(profileJSON());
+#ifdef GEOJSONVT_PROFILE
+    if (!suite.jsonOutput()) {
+        const auto profile = getProfile();
+        for (std::size_t i = 0; i < static_cast<std::size_t>(Counter::count); ++i) {
+            std::printf("%-24s %llu\n", counterName(static_cast<Counter>(i)),
+                        static_cast<unsigned long long>(profile.values[i]));
         }
     }
-    timer("getTile, found " + std::to_string(count) + " features");
+#endif
 }
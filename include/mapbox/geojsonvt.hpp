@@ -1,14 +1,33 @@
 #pragma once
 
 #include <mapbox/geojsonvt/convert.hpp>
+#include <mapbox/geojsonvt/index_file.hpp>
+#include <mapbox/geojsonvt/spill.hpp>
+#include <mapbox/geojsonvt/thread_pool.hpp>
 #include <mapbox/geojsonvt/tile.hpp>
+#include <mapbox/geojsonvt/tile_cache.hpp>
+#include <mapbox/geojsonvt/tile_table.hpp>
 #include <mapbox/geojsonvt/types.hpp>
 #include <mapbox/geojsonvt/wrap.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace mapbox {
 namespace geojsonvt {
@@ -35,7 +54,9 @@ struct Options {
     // max zoom to preserve detail on
     uint8_t maxZoom = 18;
 
-    // max zoom in the tile index
+    // max zoom in the tile index; tiles below it are clipped on demand by getTile, so a low value
+    // (down to 0, which only builds the top tile) gives a lazy index whose construction is cheap
+    // and whose memory use follows the tiles actually requested, especially with a cache budget
     uint8_t indexMaxZoom = 5;
 
     // max number of points per tile in the tile index
@@ -47,163 +68,1520 @@ struct Options {
     // simplification tolerance (higher means simpler)
     double tolerance = 3;
 
-    // tile extent
+    // max number of points per output tile (0 means no limit); tiles with more are simplified
+    // further, dropping the points lower zooms drop first, until they fit, which bounds the time
+    // and size of any one tile; points and the ends and clipped edges of lines are always kept
+    uint32_t maxPointsPerTile = 0;
+
+    // tile extent; extent plus buffer must fit the tile coordinate type, i.e. stay within 32767
+    // for the default 16-bit tiles
     uint16_t extent = 4096;
 
     // tile buffer on each side
     uint16_t buffer = 64;
+
+    // number of threads used to convert the features and build the tile index (0 or 1 builds it
+    // on the calling thread); the resulting tiles are identical to the single-threaded ones
+    uint32_t threads = 1;
+
+    // max number of tiles generated by getTile drill-downs to keep around (0 means no limit);
+    // the least recently used ones are evicted and regenerated from the index when requested
+    uint32_t maxCachedTiles = 0;
+
+    // max approximate number of bytes held by those tiles (0 means no limit)
+    std::size_t maxCacheBytes = 0;
+
+    // min number of source features for an index tile to get a spatial index when caching, built
+    // on its first drill-down; drill-downs from it then only go through the features near the
+    // requested tile, and only build the tiles on the way to it (0 never builds one)
+    uint32_t drillIndexFeatures = 1024;
+
+    // whether to keep the projected features that have an id, so that they can be removed or
+    // updated later on
+    bool updatable = false;
+
+    // file to write the source features of the index tiles out to once the index is built, so
+    // they're only read back in while tiles are drilled down from them (empty keeps them in
+    // memory); the file is created, and removed along with the index; with `fixedPoint`, x and y
+    // are written as differences of grid indexes, which take a byte or two for nearby points
+    std::string spillPath;
+
+    // max approximate number of bytes of source features read back in from the spill file to
+    // keep around (0 means no limit); the least recently used ones are dropped again
+    std::size_t spillResidentBytes = 0;
+
+    // number of worker threads getTileAsync drills down on, started on its first call (0 drills
+    // down on the calling thread, as getTile does)
+    uint32_t asyncThreads = 1;
+
+    // whether tiles are only transformed into their output the first time getTile or getTiles
+    // returns them, instead of as they're tiled; until then, tiles that split further keep the
+    // clipped features they'd be transformed from, trading memory for the index tiles that are
+    // never requested, and the tiles of getInternalTiles may not have their output features yet
+    bool lazyTiles = false;
+
+    // whether tiles encoded by getEncodedTile only keep their encoded bytes, dropping their output
+    // features; getTile can't return those tiles anymore, and the index can't be updated or saved
+    bool encodedOnly = false;
+
+    // whether projected coordinates are snapped to a fixed-point world grid of maxZoom +
+    // log2(extent) bits, i.e. to the pixels of max zoom tiles, as they're converted and clipped, so
+    // that integral tiles are transformed with integer shifts; the extent must be a power of 2 and
+    // the grid at most 32 bits, and lower zoom tiles may differ from the default ones by the
+    // snapping of the clipped edges
+    bool fixedPoint = false;
 };
 
 const Tile empty_tile{};
 
+namespace detail {
+
+// the tile getTile returns for tiles without any features
+template <class T>
+inline const BasicTile<T>& emptyTile() {
+    static const BasicTile<T> tile{};
+    return tile;
+}
+
+template <>
+inline const Tile& emptyTile<int16_t>() {
+    return empty_tile;
+}
+
+// simplification tolerance for the projected source geometry, which is kept at max zoom detail
+inline double sourceTolerance(const Options& options) {
+    const uint32_t z2 = std::pow(2, options.maxZoom);
+    return (options.tolerance / options.extent) / z2;
+}
+
+// the number of grid cells per world unit with Options::fixedPoint, 0 without it
+inline double fixedGrid(const Options& options) {
+    if (!options.fixedPoint)
+        return 0;
+    if (options.extent == 0 || (options.extent & (options.extent - 1)) != 0)
+        throw std::runtime_error("Fixed-point coordinates need a power of 2 extent");
+    const int bits = options.maxZoom + std::ilogb(options.extent);
+    if (bits > 32)
+        throw std::runtime_error("Fixed-point coordinates need maxZoom + log2(extent) <= 32");
+    return std::ldexp(1.0, bits);
+}
+
+// converts on up to `threads` threads, if there are enough features to split between them
+inline vt_features convert(const mapbox::geometry::feature_collection<double>& features,
+                           const double tolerance,
+                           const uint32_t threads,
+                           const bool monotone,
+                           const double grid = 0) {
+    if (threads > 1 && features.size() > threads) {
+        ThreadPool pool(threads);
+        return convert(features, tolerance, pool, 4 * threads, monotone, grid);
+    }
+    return convert(features, tolerance, monotone, grid);
+}
+
+// the memory usage of a zoom's tiles, which the threads changing them apply their changes to
+struct MemoryCounters {
+    std::atomic<std::size_t> sourceGeometry{ 0 };
+    std::atomic<std::size_t> sourceFeatures{ 0 };
+    std::atomic<std::size_t> properties{ 0 };
+    std::atomic<std::size_t> tileFeatures{ 0 };
+    std::atomic<std::size_t> encoded{ 0 };
+    std::atomic<std::size_t> tables{ 0 };
+
+    // moves a tile from being counted with `before` to `after`; the differences wrap around
+    // when the tile shrinks, which adding them wraps back
+    void update(const MemoryUsage& before, const MemoryUsage& after) {
+        add(sourceGeometry, after.sourceGeometry - before.sourceGeometry);
+        add(sourceFeatures, after.sourceFeatures - before.sourceFeatures);
+        add(properties, after.properties - before.properties);
+        add(tileFeatures, after.tileFeatures - before.tileFeatures);
+        add(encoded, after.encoded - before.encoded);
+        add(tables, after.tables - before.tables);
+    }
+
+    MemoryUsage load() const {
+        MemoryUsage usage;
+        usage.sourceGeometry = sourceGeometry.load(std::memory_order_relaxed);
+        usage.sourceFeatures = sourceFeatures.load(std::memory_order_relaxed);
+        usage.properties = properties.load(std::memory_order_relaxed);
+        usage.tileFeatures = tileFeatures.load(std::memory_order_relaxed);
+        usage.encoded = encoded.load(std::memory_order_relaxed);
+        usage.tables = tables.load(std::memory_order_relaxed);
+        return usage;
+    }
+
+private:
+    static void add(std::atomic<std::size_t>& counter, const std::size_t delta) {
+        if (delta)
+            counter.fetch_add(delta, std::memory_order_relaxed);
+    }
+};
+
+
+// the number of tiles per zoom as an index's `stats` shows them: a read-only map from zoom to
+// count that only has the zooms with tiles, read from the counters as it's used, so it's safe to
+// use while other threads call getTile; counts only ever go up
+class TileStats {
+public:
+    using counters = std::map<uint8_t, std::atomic<uint32_t>>;
+    using key_type = uint8_t;
+    using mapped_type = uint32_t;
+    using value_type = std::pair<uint8_t, uint32_t>;
+    using size_type = std::size_t;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = TileStats::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        const_iterator(counters::const_iterator pos_, counters::const_iterator end_)
+            : pos(pos_), end(end_) {
+            skip();
+        }
+
+        reference operator*() const {
+            return value;
+        }
+        pointer operator->() const {
+            return &value;
+        }
+        const_iterator& operator++() {
+            ++pos;
+            skip();
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator result = *this;
+            ++*this;
+            return result;
+        }
+        bool operator==(const const_iterator& other) const {
+            return pos == other.pos;
+        }
+        bool operator!=(const const_iterator& other) const {
+            return pos != other.pos;
+        }
+
+    private:
+        counters::const_iterator pos;
+        counters::const_iterator end;
+        value_type value;
+
+        // the count is read once per step, so the value doesn't change under the caller
+        void skip() {
+            for (; pos != end; ++pos) {
+                value = { pos->first, pos->second.load() };
+                if (value.second)
+                    return;
+            }
+        }
+    };
+    using iterator = const_iterator;
+
+    explicit TileStats(const counters& counts_) : counts(&counts_) {
+    }
+
+    const_iterator begin() const {
+        return { counts->begin(), counts->end() };
+    }
+    const_iterator end() const {
+        return { counts->end(), counts->end() };
+    }
+
+    const_iterator find(const uint8_t z) const {
+        const auto pos = counts->find(z);
+        if (pos == counts->end() || !pos->second.load())
+            return end();
+        return { pos, counts->end() };
+    }
+
+    // 0 for zooms without tiles, which aren't added
+    uint32_t operator[](const uint8_t z) const {
+        const auto pos = counts->find(z);
+        return pos != counts->end() ? pos->second.load() : 0;
+    }
+
+    uint32_t at(const uint8_t z) const {
+        const uint32_t count = (*this)[z];
+        if (!count)
+            throw std::out_of_range("No tiles at that zoom");
+        return count;
+    }
+
+    size_type count(const uint8_t z) const {
+        return (*this)[z] ? 1 : 0;
+    }
+
+    size_type size() const {
+        return static_cast<size_type>(std::distance(begin(), end()));
+    }
+
+    bool empty() const {
+        return begin() == end();
+    }
+
+    // a snapshot, as the map `stats` used to be
+    operator std::map<uint8_t, uint32_t>() const {
+        return { begin(), end() };
+    }
+
+private:
+    const counters* counts;
+};
+
+} // namespace detail
+
 inline uint64_t toID(uint8_t z, uint32_t x, uint32_t y) {
     return (((1ull << z) * y + x) * 32) + z;
 }
 
-class GeoJSONVT {
+/* projected and simplified features, converted once and shared read-only by several tile
+ * indexes: each index wraps and tiles them with its own options, e.g. another max zoom, extent
+ * or buffer, and only takes the ones its filter passes, while their geometry and properties
+ * stay shared with the store instead of being copied
+ *
+ * the features are simplified with the lowest source tolerance of the indexes they're for, with
+ * monotone importance (see simplify), so the points above any higher tolerance are the ones a
+ * simplification with that tolerance keeps; each index drops the points below its own source
+ * tolerance, so its tiles don't depend on the other indexes sharing the store, and its max zoom
+ * tiles are the same as if it had converted the features itself, while lower zooms may leave
+ * out a few points whose importance only the regular conversion ranks above their neighbours'
+ */
+class FeatureStore {
+public:
+    // converts `features` for indexes with any of `options`
+    FeatureStore(const mapbox::geometry::feature_collection<double>& features,
+                 const std::vector<Options>& options,
+                 const uint32_t threads = 1)
+        : tolerance(minTolerance(options)),
+          grid(commonGrid(options)),
+          converted(detail::convert(features, tolerance, threads, true, grid)) {
+    }
+
+    FeatureStore(const geojson& geojson_,
+                 const std::vector<Options>& options,
+                 const uint32_t threads = 1)
+        : FeatureStore(geojson::visit(geojson_, ToFeatureCollection{}), options, threads) {
+    }
+
+    // the source tolerance the features were simplified with, which an index's options must not
+    // go below
+    const double tolerance;
+
+    // the fixed-point grid the features are on, if all of the indexes snap them to the same one
+    const double grid;
+
+    const detail::vt_features& features() const {
+        return converted;
+    }
+
+private:
+    const detail::vt_features converted;
+
+    static double minTolerance(const std::vector<Options>& options) {
+        if (options.empty())
+            throw std::runtime_error("Feature store needs the options of at least one index");
+        double min = detail::sourceTolerance(options.front());
+        for (const auto& option : options) {
+            min = std::min(detail::sourceTolerance(option), min);
+        }
+        return min;
+    }
+
+    static double commonGrid(const std::vector<Options>& options) {
+        const double grid = detail::fixedGrid(options.front());
+        for (const auto& option : options) {
+            if (detail::fixedGrid(option) != grid)
+                return 0;
+        }
+        return grid;
+    }
+};
+
+// which features of a store an index takes, by their properties
+using FeatureFilter = std::function<bool(const mapbox::geometry::property_map&)>;
+
+template <class T>
+class BasicGeoJSONVT {
+    using InternalTile = detail::BasicInternalTile<T>;
+    using TileTable = detail::BasicTileTable<T>;
+
 public:
+    // what getInternalTiles returns, a map from tile id to tile
+    using InternalTiles = detail::BasicTileView<T>;
+
     const Options options;
 
-    GeoJSONVT(const mapbox::geometry::feature_collection<double>& features_,
+    BasicGeoJSONVT(const mapbox::geometry::feature_collection<double>& features_,
               const Options& options_ = Options())
-        : options(options_) {
+        : BasicGeoJSONVT(convert(features_, options_), options_) {
+    }
+
+    BasicGeoJSONVT(const geojson& geojson_, const Options& options_ = Options())
+        : BasicGeoJSONVT(geojson::visit(geojson_, ToFeatureCollection{}), options_) {
+    }
 
-        const uint32_t z2 = std::pow(2, options.maxZoom);
+    // tiles the features of `store` that `filter` passes, or all of them without one; the store
+    // may be destroyed once the index is built, which keeps the geometry it shares
+    BasicGeoJSONVT(const FeatureStore& store,
+                   const Options& options_ = Options(),
+                   const FeatureFilter& filter = {})
+        : BasicGeoJSONVT(select(store, options_, filter), options_) {
+    }
 
-        auto converted = detail::convert(features_, (options.tolerance / options.extent) / z2);
-        auto features = detail::wrap(converted, double(options.buffer) / options.extent);
+    // builds an index from features added one by one, e.g. by a streaming parser; each feature
+    // is projected and simplified right away, so the caller can discard it after adding it
+    class Builder {
+    public:
+        explicit Builder(const Options& options_ = Options())
+            : options(options_),
+              converter(detail::sourceTolerance(options_), false, detail::fixedGrid(options_)) {
+        }
 
-        splitTile(features, 0, 0, 0);
+        void addFeature(const mapbox::geometry::feature<double>& feature) {
+            converter.add(feature);
+        }
+
+        void addFeature(const mapbox::geometry::geometry<double>& geom,
+                        const mapbox::geometry::property_map& props = {},
+                        const detail::optional<mapbox::geometry::identifier>& id = {}) {
+            converter.add(geom, props, id);
+        }
+
+        // tiles the features added so far; the builder is empty afterwards
+        std::unique_ptr<BasicGeoJSONVT> build() {
+            return std::unique_ptr<BasicGeoJSONVT>(new BasicGeoJSONVT(converter.finish(), options));
+        }
+
+    private:
+        const Options options;
+        detail::Converter converter;
+    };
+
+    // number of tiles in total; safe to read while other threads call getTile
+    std::atomic<uint32_t> total{ 0 };
+
+    // number of tiles per zoom, for the zooms that have any; reading `stats[z]`, iterating it or
+    // copying it into a std::map works as with the map it used to be, while it can't be changed
+    // anymore and its counts are read as it's used; safe while other threads call getTile
+    const detail::TileStats stats{ tileCounts };
+
+    // a snapshot of `stats`
+    std::map<uint8_t, uint32_t> getStats() const {
+        return stats;
     }
 
-    GeoJSONVT(const geojson& geojson_, const Options& options_ = Options())
-        : GeoJSONVT(geojson::visit(geojson_, ToFeatureCollection{}), options_) {
+    // rough number of bytes held by the tiles of each zoom, kept up to date as tiles are built,
+    // drilled down from, transformed, encoded and evicted, so reading it only takes a look at
+    // the counters of each zoom; safe to read while other threads call getTile, and tiles of a
+    // loaded index only count once they're decoded
+    std::map<uint8_t, MemoryUsage> memoryUsage() const {
+        std::map<uint8_t, MemoryUsage> result;
+        for (const auto& zoom : memory) {
+            result.emplace(zoom.first, zoom.second.load());
+        }
+        return result;
     }
 
-    std::map<uint8_t, uint32_t> stats;
-    uint32_t total = 0;
+    // the same for all zooms together, along with the tile table's buckets
+    MemoryUsage totalMemoryUsage() const {
+        MemoryUsage result;
+        for (const auto& zoom : memory) {
+            result += zoom.second.load();
+        }
+        result.tables += tiles.bucketBytes();
+        return result;
+    }
 
-    const Tile& getTile(const uint8_t z, const uint32_t x_, const uint32_t y) {
+    // safe to call from several threads at once; tiles that are already cached are looked up
+    // under a shared lock, and requests drilling down from the same parent tile wait for each
+    // other instead of clipping the same geometry twice
+    //
+    // with a cache budget, drilled-down tiles may be evicted by later calls, so the returned
+    // reference is only good until the calling thread's next getTile call: until then the tile
+    // is pinned, and evictions by other threads skip it; copy the tile to keep it longer
+    const BasicTile<T>& getTile(const uint8_t z, const uint32_t x, const uint32_t y) {
+        InternalTile* tile = lookupTile(z, x, y);
+        return tile ? output(*tile) : detail::emptyTile<T>();
+    }
 
+    // the tile getTile would return, encoded with `encode(tile)`, e.g. into a vector tile with
+    // encodeMVT; the bytes are kept with the tile, so later calls for it return them without
+    // encoding it again, which takes `encode` to be the same for every call
+    //
+    // safe to call from several threads at once, and the bytes are pinned the same way as the
+    // tile getTile returns
+    template <class Encode>
+    const std::string& getEncodedTile(const uint8_t z,
+                                      const uint32_t x,
+                                      const uint32_t y,
+                                      Encode&& encode) {
+        InternalTile* tile = lookupTile(z, x, y);
+        if (!tile) {
+            std::call_once(emptyEncodedFlag,
+                           [&] { emptyEncoded = encode(detail::emptyTile<T>()); });
+            return emptyEncoded;
+        }
+        if (!tile->isEncoded()) {
+            bool paged = false;
+            {
+                std::lock_guard<std::mutex> lock(tileMutex(*tile));
+                if (!tile->isTransformed())
+                    paged = pageIn(*tile);
+                tile->encode(encode, options.encodedOnly);
+                resized(*tile);
+            }
+            if (paged)
+                trimResident();
+        }
+        return tile->encoded;
+    }
+
+    // called with the tile getTile would return and a null error, or the empty tile and the
+    // exception getTile would have thrown
+    using TileCallback = std::function<void(const BasicTile<T>&, std::exception_ptr)>;
+
+    // getTile without blocking on drill-downs: tiles that already exist and are transformed are
+    // passed to `callback` right away, on the calling thread, while the others are drilled down
+    // to on the asyncThreads workers, which then call it; `callback` must not throw
+    //
+    // requests waiting for the same tile, or to drill down from the same parent tile, are merged
+    // into one job, so a burst of them clips the parent once and calls back in turn; the same
+    // caveats as getTile apply, so with a cache budget the tile is only pinned until the thread
+    // that calls back looks up another one, and the index waits for queued jobs when it's
+    // destroyed
+    void getTileAsync(const uint8_t z, const uint32_t x_, const uint32_t y, TileCallback callback) {
         if (z > options.maxZoom)
             throw std::runtime_error("Requested zoom higher than maxZoom: " + std::to_string(z));
 
-        const uint32_t z2 = std::pow(2, z);
+        const uint32_t z2 = 1u << z;
         const uint32_t x = ((x_ % z2) + z2) % z2; // wrap tile x coordinate
         const uint64_t id = toID(z, x, y);
 
-        auto it = tiles.find(id);
-        if (it != tiles.end())
-            return it->second.tile;
+        InternalTile* tile = pinTile(id);
+        if (!options.asyncThreads || (tile && tile->isTransformed())) {
+            runRequest({ z, x, y, { std::move(callback) } });
+            return;
+        }
+
+        uint64_t parentID = id;
+        if (!tile)
+            findParent(z, x, y, parentID);
+
+        std::lock_guard<std::mutex> lock(asyncMutex);
+        auto& job = asyncJobs[parentID];
+        const bool queued = !job.empty();
+        auto request = std::find_if(job.begin(), job.end(), [&](const AsyncRequest& r) {
+            return r.z == z && r.x == x && r.y == y;
+        });
+        if (request != job.end())
+            request->callbacks.push_back(std::move(callback));
+        else
+            job.push_back({ z, x, y, { std::move(callback) } });
+        if (!queued) {
+            std::call_once(asyncPoolFlag, [this] {
+                asyncPool = std::make_unique<detail::ThreadPool>(options.asyncThreads + 1);
+            });
+            asyncPool->push([this, parentID] { this->runJob(parentID); });
+        }
+    }
+
+    // the same, with a future that's ready right away for tiles that already exist
+    std::shared_future<const BasicTile<T>&>
+    getTileAsync(const uint8_t z, const uint32_t x, const uint32_t y) {
+        auto promise = std::make_shared<std::promise<const BasicTile<T>&>>();
+        std::shared_future<const BasicTile<T>&> future = promise->get_future().share();
+        getTileAsync(z, x, y, [promise](const BasicTile<T>& tile, std::exception_ptr error) {
+            if (error)
+                promise->set_exception(error);
+            else
+                promise->set_value(tile);
+        });
+        return future;
+    }
 
-        it = findParent(z, x, y);
+    // calls `callback(z, x, y, tile)` with the tile getTile would return for every tile from zmin
+    // to zmax that overlaps `bbox` (in degrees), walking the pyramid depth-first; tiles below the
+    // index are clipped once for all of their descendants and freed when the walk leaves them,
+    // instead of being added to the index
+    //
+    // the tile table is read without locking, so this must not be called while other threads
+    // call getTile
+    template <class Callback>
+    void getTiles(const uint8_t zmin,
+                  const uint8_t zmax,
+                  const mapbox::geometry::box<double>& bbox,
+                  Callback&& callback) {
+        if (zmax > options.maxZoom)
+            throw std::runtime_error("Requested zoom higher than maxZoom: " + std::to_string(zmax));
+        if (zmin > zmax)
+            return;
 
-        if (it == tiles.end())
+        auto* root = findTile(toID(0, 0, 0));
+        if (!root)
             throw std::runtime_error("Parent tile not found");
 
-        // if we found a parent tile containing the original geometry, we can drill down from it
-        const auto& parent = it->second;
+        detail::project project{ 0 };
+        const auto min = project(mapbox::geometry::point<double>{ bbox.min.x, bbox.max.y });
+        const auto max = project(mapbox::geometry::point<double>{ bbox.max.x, bbox.min.y });
+        walkTile(*root, TileRange{ zmin, zmax, min.x, min.y, max.x, max.y }, callback);
+        detail::scratchArena().release();
+    }
 
-        // parent tile is a solid clipped square, return it instead since it's identical
-        if (parent.is_solid)
-            return parent.tile;
+    // adds a feature to the index, clipping it only into the tiles it overlaps; drilled-down
+    // tiles are updated in place, or dropped to be drilled down to again when caching, so this
+    // must not be called while other threads call getTile
+    void insert(const mapbox::geometry::feature<double>& feature) {
+        checkUpdatable();
+        detail::Converter converter(detail::sourceTolerance(options), false,
+                                    detail::fixedGrid(options));
+        converter.add(feature);
+        auto converted = converter.finish();
+        if (options.updatable && feature.id)
+            removable.emplace(*feature.id, converted.front());
+        updateTiles(converted, nullptr);
+        detail::scratchArena().release();
+    }
 
-        // drill down parent tile up to the requested one
-        splitTile(parent.source_features, parent.z, parent.x, parent.y, z, x, y);
+    // removes the features with the given id that were added while `options.updatable` was set,
+    // either up front or with `insert`; false if there were none
+    bool remove(const mapbox::geometry::identifier& id) {
+        checkUpdatable();
+        const auto range = removable.equal_range(id);
+        if (range.first == range.second)
+            return false;
 
-        it = tiles.find(id);
-        if (it != tiles.end())
-            return it->second.tile;
+        detail::vt_features removed;
+        for (auto it = range.first; it != range.second; ++it) {
+            removed.push_back(it->second);
+        }
+        removable.erase(range.first, range.second);
+        updateTiles(removed, &id);
+        detail::scratchArena().release();
+        return true;
+    }
 
-        it = findParent(z, x, y);
-        if (it == tiles.end())
-            throw std::runtime_error("Parent tile not found");
+    // replaces the features that have the same id as this one, e.g. to move a vehicle
+    void update(const mapbox::geometry::feature<double>& feature) {
+        if (!feature.id)
+            throw std::runtime_error("Can't update a feature without an id");
+        remove(*feature.id);
+        insert(feature);
+    }
 
-        // drilling stopped because parent was a solid square; return it instead
-        if (it->second.is_solid)
-            return it->second.tile;
+    // tiles of a loaded index are only listed once getTile has looked them up
+    InternalTiles getInternalTiles() const {
+        return InternalTiles(tiles);
+    }
+
+    // writes the tile index, including tiles drilled down to so far, to a file that `load` maps
+    // back in; must not be called while other threads call getTile
+    void save(const std::string& path) const {
+        if (options.encodedOnly)
+            throw std::runtime_error("Can't save an index that only keeps encoded tiles");
+        detail::IndexHeader header;
+        header.maxZoom = options.maxZoom;
+        header.indexMaxZoom = options.indexMaxZoom;
+        header.indexMaxPoints = options.indexMaxPoints;
+        header.solidChildren = options.solidChildren;
+        header.tolerance = options.tolerance;
+        header.maxPointsPerTile = options.maxPointsPerTile;
+        header.extent = options.extent;
+        header.buffer = options.buffer;
+        header.coordinates = detail::coordinateType<T>();
+        header.fixedPoint = options.fixedPoint;
+        header.total = total;
+        for (const auto& stat : getStats()) {
+            header.stats.push_back(stat);
+        }
 
-        // otherwise it was an empty tile
-        return empty_tile;
+        detail::IndexFileWriter writer(path, header);
+        for (const auto& pair : tiles) {
+            // spilled source features are read in just for writing them
+            if (spill && pair.second.source_features.empty() && spill->contains(pair.first))
+                writer.writeTile(pair.first, pair.second, spill->read(pair.first));
+            else
+                writer.writeTile(pair.first, pair.second);
+            // lazy tiles are transformed to be written
+            account(pair.second);
+        }
+        // tiles of a loaded index that were never looked up are copied over as they are
+        if (archive) {
+            for (std::size_t i = 0; i < archive->size(); ++i) {
+                const uint64_t id = archive->idAt(i);
+                if (!tiles.find(id)) {
+                    const auto record = archive->record(i);
+                    writer.writeRecord(id, record.first, record.second);
+                }
+            }
+        }
+        writer.finish();
     }
 
-    const std::unordered_map<uint64_t, detail::InternalTile>& getInternalTiles() const {
-        return tiles;
+    // opens a tile index written by `save` without tiling the data again; tiles are decoded
+    // from the memory-mapped file the first time they're looked up, and drilling down below
+    // them works as usual; the tiling options are read from the file, while the other ones
+    // (e.g. the cache budget) are taken from `options_`
+    static std::unique_ptr<BasicGeoJSONVT> load(const std::string& path,
+                                           const Options& options_ = Options()) {
+        auto archive = std::make_unique<const detail::IndexFile>(path);
+        return std::unique_ptr<BasicGeoJSONVT>(new BasicGeoJSONVT(std::move(archive), options_));
     }
 
 private:
-    std::unordered_map<uint64_t, detail::InternalTile> tiles;
+    TileTable tiles;
 
-    std::unordered_map<uint64_t, detail::InternalTile>::iterator
-    findParent(const uint8_t z, const uint32_t x, const uint32_t y) {
-        uint8_t z0 = z;
-        uint32_t x0 = x;
-        uint32_t y0 = y;
+    // number of tiles per zoom, with an entry for every zoom
+    std::map<uint8_t, std::atomic<uint32_t>> tileCounts;
 
-        const auto end = tiles.end();
-        auto parent = end;
+    // the memory usage of each zoom's tiles, which every zoom has an entry in
+    mutable std::map<uint8_t, detail::MemoryCounters> memory;
 
-        while ((parent == end) && (z0 != 0)) {
-            z0--;
-            x0 = x0 / 2;
-            y0 = y0 / 2;
-            parent = tiles.find(toID(z0, x0, y0));
+    // saved tiles that haven't been decoded into `tiles` yet, if the index was loaded
+    std::unique_ptr<const detail::IndexFile> archive;
+
+    // unwrapped features kept for `remove`, if the index is updatable
+    std::unordered_multimap<mapbox::geometry::identifier, detail::vt_feature, detail::identifier_hash>
+        removable;
+
+    // drill-down locks, striped over parent tiles the same way as the tile table shards
+    std::array<std::mutex, TileTable::shard_count> drillMutexes;
+
+    // drilled-down tiles that count against the cache budget, guarded by cacheMutex, and the
+    // tiles threads are reading, which aren't evicted
+    detail::TileCache cache;
+    std::mutex cacheMutex;
+    detail::TilePins pins;
+
+    // what getEncodedTile returns for empty tiles, encoded on its first call
+    std::string emptyEncoded;
+    std::once_flag emptyEncodedFlag;
+
+    // where the source features of index tiles were written out to, if they're spilled; the
+    // tiles whose source features were read back in are guarded by spillMutex
+    std::unique_ptr<detail::SpillFile> spill;
+    detail::TileCache resident;
+    std::mutex spillMutex;
+
+    // a tile getTileAsync was asked for, and the callbacks waiting for it
+    struct AsyncRequest {
+        uint8_t z;
+        uint32_t x;
+        uint32_t y;
+        std::vector<TileCallback> callbacks;
+    };
+
+    // queued getTileAsync requests by the tile they drill down from, guarded by asyncMutex;
+    // the workers are declared last, so they're joined before anything they use goes away
+    std::unordered_map<uint64_t, std::vector<AsyncRequest>> asyncJobs;
+    std::mutex asyncMutex;
+    std::once_flag asyncPoolFlag;
+    std::unique_ptr<detail::ThreadPool> asyncPool;
+
+    BasicGeoJSONVT(detail::vt_features converted, const Options& options_)
+        : options(options_) {
+        detail::checkExtent<T>(options.extent, options.buffer);
+
+        // every zoom has an entry, so counters can be bumped concurrently without inserting
+        for (uint8_t z = 0; z <= options.maxZoom; ++z) {
+            tileCounts[z] = 0;
+            memory[z];
         }
 
-        return parent;
+        if (options.updatable) {
+            for (const auto& feature : converted) {
+                if (feature.id)
+                    removable.emplace(*feature.id, feature);
+            }
+        }
+
+        auto features =
+            detail::wrap(converted, double(options.buffer) / options.extent, grid());
+
+        std::deque<InternalTile> built;
+        built.emplace_back(features, 0, 0, 0, options.extent, options.buffer, tileTolerance(0),
+                           options.lazyTiles, options.maxPointsPerTile,
+                           detail::sourceTolerance(options), grid());
+
+        if (options.threads > 1) {
+            detail::ThreadPool pool(options.threads);
+
+            // fork until there are a few subtrees per thread to even out uneven data
+            uint8_t forkZoom = 0;
+            while (forkZoom < options.indexMaxZoom &&
+                   (1ull << (2 * forkZoom)) < 4ull * options.threads)
+                forkZoom++;
+
+            splitTile(std::move(features), built.front(), 0, 0, 0, built, &pool, forkZoom);
+        } else {
+            splitTile(std::move(features), built.front(), 0, 0, 0, built);
+        }
+        detail::scratchArena().release();
+
+        if (!options.spillPath.empty()) {
+            spill = std::make_unique<detail::SpillFile>(options.spillPath, grid());
+            for (auto& tile : built) {
+                spillTile(tile);
+            }
+        }
+
+        // `built` is in depth-first order either way, so `tiles` ends up identical
+        for (auto& tile : built) {
+            addTile(std::move(tile));
+        }
+    }
+
+    // writes the source features of a tile out to the spill file and drops them
+    void spillTile(InternalTile& tile) {
+        if (tile.source_features.empty())
+            return;
+        const uint64_t id = toID(tile.z, tile.x, tile.y);
+        spill->write(id, tile.source_features);
+        detail::vt_features().swap(tile.source_features);
+        GEOJSONVT_COUNT(Counter::paged_out_tiles, 1);
+    }
+
+    // reads the source features of a spilled tile back in if they were dropped, and tells
+    // whether they were; the tile's drill lock is held, or no other thread calls getTile
+    bool pageIn(InternalTile& tile) {
+        if (!spill)
+            return false;
+        const uint64_t id = toID(tile.z, tile.x, tile.y);
+        if (!spill->contains(id))
+            return false;
+        std::unique_lock<std::mutex> lock(spillMutex);
+        if (!tile.source_features.empty()) {
+            resident.touch(id);
+            return false;
+        }
+        lock.unlock();
+
+        {
+            GEOJSONVT_TIME(Counter::page_in_calls);
+            tile.source_features = spill->read(id);
+        }
+        account(tile);
+        lock.lock();
+        resident.add(id, detail::estimateBytes(tile.source_features));
+        return true;
+    }
+
+    // a spilled tile gave its source features away to its children, so there's nothing left to
+    // read back in; the tile's drill lock is held
+    void forgetSpilled(const uint64_t id) {
+        if (!spill)
+            return;
+        spill->erase(id);
+        std::lock_guard<std::mutex> lock(spillMutex);
+        resident.remove(id);
+    }
+
+    // drops the least recently read in source features over the resident budget; tiles being
+    // drilled down from right now are skipped, so no drill lock may be held
+    void trimResident() {
+        if (!spill || !options.spillResidentBytes)
+            return;
+        std::lock_guard<std::mutex> lock(spillMutex);
+
+        std::size_t attempts = resident.size();
+        while (attempts-- > 0 && resident.bytes() > options.spillResidentBytes) {
+            const uint64_t victim = *resident.begin();
+            std::unique_lock<std::mutex> drill(drillMutexes[TileTable::shardIndex(victim)],
+                                               std::try_to_lock);
+            if (!drill) {
+                resident.touch(victim);
+                continue;
+            }
+            if (auto* tile = tiles.find(victim)) {
+                detail::vt_features().swap(tile->source_features);
+                account(*tile);
+                GEOJSONVT_COUNT(Counter::paged_out_tiles, 1);
+            }
+            resident.remove(victim);
+        }
+    }
+
+    static detail::vt_features convert(const mapbox::geometry::feature_collection<double>& features,
+                                       const Options& options_) {
+        return detail::convert(features, detail::sourceTolerance(options_), options_.threads,
+                               false, detail::fixedGrid(options_));
+    }
+
+    // the features of a store an index takes; they're copies sharing the store's geometry
+    static detail::vt_features
+    select(const FeatureStore& store, const Options& options_, const FeatureFilter& filter) {
+        if (store.tolerance > detail::sourceTolerance(options_))
+            throw std::runtime_error("Feature store simplified too coarsely for the index options");
+        if (store.grid != detail::fixedGrid(options_))
+            throw std::runtime_error("Feature store not on the fixed-point grid of the index");
+        if (!filter)
+            return store.features();
+        detail::vt_features selected;
+        for (const auto& feature : store.features()) {
+            if (filter(*feature.properties))
+                selected.push_back(feature);
+        }
+        return selected;
+    }
+
+    BasicGeoJSONVT(std::unique_ptr<const detail::IndexFile> archive_, const Options& options_)
+        : options(savedOptions(archive_->getHeader(), options_)), archive(std::move(archive_)) {
+        if (archive->getHeader().coordinates != detail::coordinateType<T>())
+            throw std::runtime_error("Invalid tile index: saved with another coordinate type");
+        for (uint8_t z = 0; z <= options.maxZoom; ++z) {
+            tileCounts[z] = 0;
+            memory[z];
+        }
+        for (const auto& stat : archive->getHeader().stats) {
+            if (stat.first > options.maxZoom)
+                throw std::runtime_error("Invalid tile index: tile zoom higher than maxZoom");
+            tileCounts[stat.first] = stat.second;
+        }
+        total = archive->getHeader().total;
+    }
+
+    static Options savedOptions(const detail::IndexHeader& header, Options options_) {
+        options_.maxZoom = header.maxZoom;
+        options_.indexMaxZoom = header.indexMaxZoom;
+        options_.indexMaxPoints = header.indexMaxPoints;
+        options_.solidChildren = header.solidChildren;
+        options_.tolerance = header.tolerance;
+        options_.maxPointsPerTile = header.maxPointsPerTile;
+        options_.extent = header.extent;
+        options_.buffer = header.buffer;
+        options_.fixedPoint = header.fixedPoint;
+        return options_;
+    }
+
+    // looks a tile up, decoding it from the loaded index file if needed; decoded tiles are
+    // already counted in `tileCounts`
+    InternalTile* findTile(const uint64_t id) {
+        if (auto* tile = tiles.find(id))
+            return tile;
+        if (!archive || !archive->contains(id))
+            return nullptr;
+        auto decoded = archive->decode<T>(id, tileTolerance(id % 32),
+                                          detail::sourceTolerance(options), grid());
+        account(decoded);
+        const MemoryUsage counted = decoded.counted;
+        const auto result = tiles.emplace(id, std::move(decoded));
+        // another thread may have decoded the tile first, then this copy isn't kept
+        if (!result.second)
+            memory.at(result.first->z).update(counted, {});
+        return result.first;
+    }
+
+    // looks up a tile to hand it out; with a cache budget, it's pinned until the calling thread
+    // looks up another one, so evictions leave it alone meanwhile
+    InternalTile* pinTile(const uint64_t id) {
+        if (!caching())
+            return findTile(id);
+        // a tile decoded from the loaded index is pinned by looking it up again
+        auto& pin = pins.slot();
+        auto* tile = tiles.find(id, pin);
+        return tile || !findTile(id) ? tile : tiles.find(id, pin);
+    }
+
+    bool hasTile(const uint64_t id) const {
+        return tiles.find(id) || (archive && archive->contains(id));
+    }
+
+    // the tile getTile returns, drilling down to it if needed, or null for an empty tile
+    InternalTile* lookupTile(const uint8_t z, const uint32_t x_, const uint32_t y) {
+        if (z > options.maxZoom)
+            throw std::runtime_error("Requested zoom higher than maxZoom: " + std::to_string(z));
+
+        const uint32_t z2 = std::pow(2, z);
+        const uint32_t x = ((x_ % z2) + z2) % z2; // wrap tile x coordinate
+        const uint64_t id = toID(z, x, y);
+
+        while (true) {
+            if (auto* tile = pinTile(id)) {
+                GEOJSONVT_COUNT(Counter::cache_hits, 1);
+                touchTile(id);
+                return tile;
+            }
+
+            uint64_t parentID;
+            if (!findParent(z, x, y, parentID))
+                throw std::runtime_error("Parent tile not found");
+
+            // a cached parent may be evicted until we hold its drill lock, so look it up again
+            std::unique_lock<std::mutex> lock(drillMutexes[TileTable::shardIndex(parentID)]);
+            auto* parent = findTile(parentID);
+            if (!parent)
+                continue;
+
+            // parent tile is a solid clipped square, return it instead since it's identical
+            if (parent->is_solid) {
+                GEOJSONVT_COUNT(Counter::cache_hits, 1);
+                return pinTile(parentID);
+            }
+
+            // another request may have drilled down from the same parent while we waited, then
+            // its child on the way to the requested tile exists
+            const uint8_t dz = z - parent->z - 1;
+            if (hasTile(toID(parent->z + 1, x >> dz, y >> dz)))
+                continue;
+
+            GEOJSONVT_COUNT(Counter::cache_misses, 1);
+
+            // nothing to drill down from, e.g. a tile with no features at all
+            const bool paged = pageIn(*parent);
+            if (parent->source_features.empty())
+                return nullptr;
+
+            // index tiles keep their source features when caching, so that evicted tiles can
+            // always be drilled down to again
+            const bool pinned = caching() && !isCached(parentID);
+
+            // if we found a parent tile containing the original geometry, we can drill down from
+            // it up to the requested one; pinned features are only read, others consumed
+            std::deque<InternalTile> built;
+            {
+                GEOJSONVT_TIME(Counter::drill_downs);
+                if (pinned && options.drillIndexFeatures &&
+                    parent->source_features.size() >= options.drillIndexFeatures) {
+                    drillIndexed(*parent, z, x, y, built);
+                } else if (pinned) {
+                    splitChildren(parent->source_features, *parent, z, x, y, built);
+                } else {
+                    parent->keepPending(parent->source_features);
+                    forgetSpilled(parentID);
+                    auto features = std::move(parent->source_features);
+                    splitChildren(std::move(features), *parent, z, x, y, built);
+                }
+            }
+            account(*parent);
+            GEOJSONVT_COUNT(Counter::drilled_tiles, built.size());
+
+            // the new tiles are cached before they're stored, so evicting one of them always takes
+            // along the new parents that gave their source features away to it; evicting a tile
+            // that isn't stored yet fails
+            if (caching()) {
+                std::vector<std::pair<uint64_t, std::size_t>> added;
+                for (const auto& tile : built) {
+                    added.emplace_back(toID(tile.z, tile.x, tile.y), detail::estimateBytes(tile));
+                }
+                cacheTiles(added);
+            }
+
+            // children go in before their parents, so other threads never find a tile that gave
+            // its source features away to children that aren't there yet
+            for (auto it = built.rbegin(); it != built.rend(); ++it) {
+                addTile(std::move(*it));
+            }
+
+            // drilling may have stopped early because a parent was a solid square, then return
+            // that instead since it's identical; otherwise it was an empty tile, unless it stopped
+            // at a tile on the way that another thread stored meanwhile, which is then drilled
+            // down from next. Tiles are pinned before they're read, since an ancestor other than
+            // the parent may be cached already
+            InternalTile* result = pinTile(id);
+            bool retry = false;
+            if (!result) {
+                uint64_t ancestorID;
+                auto* ancestor = findParent(z, x, y, ancestorID) ? pinTile(ancestorID) : nullptr;
+                if (ancestor && ancestor->is_solid)
+                    result = ancestor;
+                else if (ancestor && ancestorID != parentID)
+                    retry = std::none_of(built.begin(), built.end(), [&](const auto& tile) {
+                        return toID(tile.z, tile.x, tile.y) == ancestorID;
+                    });
+            }
+            lock.unlock();
+            // the scratch the drill-down clipped with isn't kept for the next one
+            detail::scratchArena().release();
+
+            if (paged)
+                trimResident();
+            if (caching())
+                trimCache(result ? toID(result->z, result->x, result->y) : id);
+
+            if (retry)
+                continue;
+            return result;
+        }
+    }
+
+    // takes the requests queued for a parent tile, which then go to a new job
+    void runJob(const uint64_t parentID) {
+        std::vector<AsyncRequest> requests;
+        {
+            std::lock_guard<std::mutex> lock(asyncMutex);
+            auto it = asyncJobs.find(parentID);
+            requests = std::move(it->second);
+            asyncJobs.erase(it);
+        }
+        for (const auto& request : requests) {
+            runRequest(request);
+        }
+    }
+
+    void runRequest(const AsyncRequest& request) {
+        const BasicTile<T>* tile = &detail::emptyTile<T>();
+        std::exception_ptr error;
+        try {
+            tile = &getTile(request.z, request.x, request.y);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (const auto& callback : request.callbacks) {
+            callback(*tile, error);
+        }
+    }
+
+    // the drill lock of a tile's shard, which also guards transforming and encoding the tile
+    std::mutex& tileMutex(const InternalTile& tile) {
+        return drillMutexes[TileTable::shardIndex(toID(tile.z, tile.x, tile.y))];
+    }
+
+    // the output of a tile, transforming it first if it's lazy; tiles getTiles clips below the
+    // index aren't `stored`, so they're neither counted nor cached
+    const BasicTile<T>& output(InternalTile& tile, const bool stored = true) {
+        if (!tile.isTransformed()) {
+            bool paged = false;
+            {
+                std::lock_guard<std::mutex> lock(tileMutex(tile));
+                if (!tile.isTransformed())
+                    paged = pageIn(tile);
+                tile.transform();
+                if (stored)
+                    resized(tile);
+            }
+            if (paged)
+                trimResident();
+        }
+        return tile.tile;
     }
 
-    void splitTile(const detail::vt_features& features,
-                   const uint8_t z,
+    // tiles transformed or encoded after they were counted take more or less memory than that
+    void resized(const InternalTile& tile) {
+        account(tile);
+        if (!caching())
+            return;
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        cache.resize(toID(tile.z, tile.x, tile.y), detail::estimateBytes(tile));
+    }
+
+    // zooms and projected bounds of a getTiles walk
+    struct TileRange {
+        uint8_t zmin;
+        uint8_t zmax;
+        double minX;
+        double minY;
+        double maxX;
+        double maxY;
+
+        bool contains(const uint8_t z, const uint32_t x, const uint32_t y) const {
+            const double z2 = 1u << z;
+            return x >= std::floor(minX * z2) && x <= std::floor(maxX * z2) &&
+                   y >= std::floor(minY * z2) && y <= std::floor(maxY * z2);
+        }
+    };
+
+    template <class Callback>
+    void walkTile(InternalTile& tile,
+                  const TileRange& range,
+                  Callback& callback,
+                  const bool stored = true) {
+        const uint8_t z = tile.z;
+        const uint32_t x = tile.x;
+        const uint32_t y = tile.y;
+
+        if (z >= range.zmin)
+            callback(z, x, y, output(tile, stored));
+        if (z == range.zmax)
+            return;
+
+        // tiles below a solid square are identical to it
+        if (!options.solidChildren && tile.is_solid) {
+            for (uint8_t i = 0; i < 4; ++i) {
+                emitTiles(z + 1, x * 2 + i / 2, y * 2 + i % 2, output(tile, stored), range,
+                          callback);
+            }
+            return;
+        }
+
+        const double z2 = 1u << z;
+        const double p = 0.5 * options.buffer / options.extent;
+        const bool paged = pageIn(tile);
+        const auto& sources = tile.source_features;
+        const auto& min = tile.bbox.min;
+        const auto& max = tile.bbox.max;
+
+        // the left strip is only clipped when a child in it is missing, and freed before the right
+        detail::vt_features strip;
+        int side = -1;
+
+        for (uint8_t i = 0; i < 4; ++i) {
+            const uint32_t cx = x * 2 + i / 2;
+            const uint32_t cy = y * 2 + i % 2;
+            if (!range.contains(z + 1, cx, cy))
+                continue;
+
+            if (auto* child = findTile(toID(z + 1, cx, cy))) {
+                walkTile(*child, range, callback);
+                continue;
+            }
+
+            // nothing to drill down from, e.g. a tile with no features at all
+            if (sources.empty()) {
+                emitTiles(z + 1, cx, cy, detail::emptyTile<T>(), range, callback);
+                continue;
+            }
+
+            if (side != i / 2) {
+                side = i / 2;
+                strip = detail::clip<0>(sources, (x + 0.5 * side - p) / z2,
+                                        (x + 0.5 + 0.5 * side + p) / z2, min.x, max.x, grid());
+            }
+            // the strip's second child is its last one, so it can consume the strip
+            const double k1 = (y + 0.5 * (i % 2) - p) / z2;
+            const double k2 = (y + 0.5 * (i % 2) + 0.5 + p) / z2;
+            auto features = i % 2
+                                ? detail::clip<1>(std::move(strip), k1, k2, min.y, max.y, grid())
+                                : detail::clip<1>(strip, k1, k2, min.y, max.y, grid());
+
+            InternalTile child(features, z + 1, cx, cy, options.extent, options.buffer,
+                               tileTolerance(z + 1), options.lazyTiles, options.maxPointsPerTile,
+                               detail::sourceTolerance(options), grid());
+            child.source_features = std::move(features);
+            walkTile(child, range, callback, false);
+        }
+
+        // tiles below a spilled one aren't spilled, so nothing else is read in meanwhile
+        if (paged)
+            trimResident();
+    }
+
+    // calls back with `tile` for z/x/y and all of its descendants in range
+    template <class Callback>
+    void emitTiles(const uint8_t z,
                    const uint32_t x,
                    const uint32_t y,
-                   const uint8_t cz = 0,
-                   const uint32_t cx = 0,
-                   const uint32_t cy = 0) {
+                   const BasicTile<T>& tile,
+                   const TileRange& range,
+                   Callback& callback) const {
+        if (!range.contains(z, x, y))
+            return;
+        if (z >= range.zmin)
+            callback(z, x, y, tile);
+        if (z == range.zmax)
+            return;
+        for (uint8_t i = 0; i < 4; ++i) {
+            emitTiles(z + 1, x * 2 + i / 2, y * 2 + i % 2, tile, range, callback);
+        }
+    }
 
-        const double z2 = 1u << z;
+    void checkUpdatable() const {
+        if (options.encodedOnly)
+            throw std::runtime_error("Can't update an index that only keeps encoded tiles");
+    }
+
+    // applies inserted features, or removed ones with the given id, to the tiles they overlap
+    void updateTiles(const detail::vt_features& features,
+                     const mapbox::geometry::identifier* removed) {
+        const auto wrapped =
+            detail::wrap(features, double(options.buffer) / options.extent, grid());
+        if (wrapped.empty())
+            return;
+        if (caching())
+            dropCachedTiles(featuresBBox(wrapped));
+        updateTile(0, 0, 0, wrapped, removed);
+    }
+
+    void updateTile(const uint8_t z,
+                    const uint32_t x,
+                    const uint32_t y,
+                    const detail::vt_features& features,
+                    const mapbox::geometry::identifier* removed) {
+        auto* tile = findTile(toID(z, x, y));
+        if (!tile || features.empty())
+            return;
+
+        bool split = false;
+        for (uint8_t i = 0; i < 4 && z < options.maxZoom && !split; ++i) {
+            split = hasTile(toID(z + 1, x * 2 + i / 2, y * 2 + i % 2));
+        }
+
+        // spilled source features are read in to be updated, and written out again afterwards
         const uint64_t id = toID(z, x, y);
+        const bool respill = spill && spill->contains(id);
+        if (respill)
+            pageIn(*tile);
 
-        auto it = tiles.find(id);
+        if (removed) {
+            tile->removeFeatures(*removed, features, options.buffer);
+        } else {
+            tile->addFeatures(features, options.buffer);
+            // tiles that weren't split further, or that are pinned when caching, drill down from
+            // their source features
+            if (!split || !tile->source_features.empty()) {
+                tile->source_features.insert(tile->source_features.end(), features.begin(),
+                                             features.end());
+                tile->feature_index.reset();
+            }
+        }
 
-        if (it == tiles.end()) {
-            const double tolerance =
-                (z == options.maxZoom ? 0 : options.tolerance / (z2 * options.extent));
+        if (respill) {
+            forgetSpilled(id);
+            spillTile(*tile);
+        }
+        account(*tile);
 
-            it = tiles
-                     .emplace(id, detail::InternalTile{ features, z, x, y, options.extent,
-                                                        options.buffer, tolerance })
-                     .first;
-            stats[z] = (stats.count(z) ? stats[z] + 1 : 1);
-            total++;
-            // printf("tile z%i-%i-%i\n", z, x, y);
+        if (split) {
+            const auto children = clipChildren(features, z, x, y, featuresBBox(features));
+            for (uint8_t i = 0; i < 4; ++i) {
+                updateTile(z + 1, x * 2 + i / 2, y * 2 + i % 2, children[i], removed);
+            }
         }
+    }
 
-        auto& tile = it->second;
+    // drilled-down tiles that may be affected by an update are dropped rather than updated,
+    // since some of their ancestors may have been evicted already
+    void dropCachedTiles(const mapbox::geometry::box<double>& bbox) {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+
+        const double b = double(options.buffer) / options.extent;
+        std::vector<uint64_t> dropped;
+        for (const uint64_t id : cache) {
+            const uint64_t z = id % 32;
+            const double z2 = 1ull << z;
+            const double x = (id / 32) % (1ull << z);
+            const double y = (id / 32) >> z;
+            if ((x - b) / z2 <= bbox.max.x && (x + 1 + b) / z2 >= bbox.min.x &&
+                (y - b) / z2 <= bbox.max.y && (y + 1 + b) / z2 >= bbox.min.y)
+                dropped.push_back(id);
+        }
+        for (const uint64_t id : dropped) {
+            eraseTile(id);
+            cache.remove(id);
+        }
+    }
+
+    static mapbox::geometry::box<double> featuresBBox(const detail::vt_features& features) {
+        mapbox::geometry::box<double> bbox = { { 2, 1 }, { -1, 0 } };
+        for (const auto& feature : features) {
+            bbox.min.x = std::min(feature.bbox.min.x, bbox.min.x);
+            bbox.min.y = std::min(feature.bbox.min.y, bbox.min.y);
+            bbox.max.x = std::max(feature.bbox.max.x, bbox.max.x);
+            bbox.max.y = std::max(feature.bbox.max.y, bbox.max.y);
+        }
+        return bbox;
+    }
+
+    bool caching() const {
+        return options.maxCachedTiles != 0 || options.maxCacheBytes != 0;
+    }
+
+    bool isCached(const uint64_t id) {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        return cache.contains(id);
+    }
+
+    // recency is only tracked when the cache isn't busy, so cached lookups never wait for it
+    void touchTile(const uint64_t id) {
+        if (!caching())
+            return;
+        std::unique_lock<std::mutex> lock(cacheMutex, std::try_to_lock);
+        if (lock)
+            cache.touch(id);
+    }
+
+    void cacheTiles(const std::vector<std::pair<uint64_t, std::size_t>>& added) {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        for (const auto& tile : added) {
+            cache.add(tile.first, tile.second);
+        }
+    }
+
+    // evicts tiles until the cache is within budget; `requested` is the tile being returned,
+    // which is never evicted
+    void trimCache(const uint64_t requested) {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        cache.touch(requested);
+
+        // tiles that are skipped move to the front, so each one is tried at most once
+        std::size_t attempts = cache.size();
+        while (attempts-- > 0 &&
+               ((options.maxCachedTiles && cache.size() > options.maxCachedTiles) ||
+                (options.maxCacheBytes && cache.bytes() > options.maxCacheBytes))) {
+            const uint64_t victim = *cache.begin();
+            if (!evictTile(victim, requested))
+                cache.touch(victim);
+        }
+    }
+
+    // evicts a cached tile along with the drilled-down ancestors that gave their source features
+    // away when splitting, since they can't be drilled down from without all of their children;
+    // fails if one of them is `requested`, pinned, or being drilled down from right now
+    bool evictTile(const uint64_t id, const uint64_t requested) {
+        if (id == requested)
+            return false;
+        std::vector<uint64_t> evicted{ id };
+        uint64_t z = id % 32;
+        uint64_t x = (id / 32) % (1ull << z);
+        uint64_t y = (id / 32) >> z;
+        while (z > 0) {
+            z--;
+            x /= 2;
+            y /= 2;
+            const uint64_t parentID = toID(z, x, y);
+            if (!cache.contains(parentID))
+                break;
+            if (parentID == requested)
+                return false;
+            evicted.push_back(parentID);
+        }
+
+        // drilling down from the nearest tile above them that's still stored may skip some of
+        // them because they exist, and build their missing parents, so that waits as well
+        std::vector<uint64_t> locked = evicted;
+        while (z > 0) {
+            z--;
+            x /= 2;
+            y /= 2;
+            if (hasTile(toID(z, x, y))) {
+                locked.push_back(toID(z, x, y));
+                break;
+            }
+        }
+
+        if (std::any_of(evicted.begin(), evicted.end(),
+                        [&](const uint64_t tileID) { return pins.contains(tileID); }))
+            return false;
+
+        std::vector<std::unique_lock<std::mutex>> locks;
+        for (const uint64_t tileID : locked) {
+            auto& mutex = drillMutexes[TileTable::shardIndex(tileID)];
+            if (std::none_of(locks.begin(), locks.end(),
+                             [&](const auto& lock) { return lock.mutex() == &mutex; })) {
+                locks.emplace_back(mutex, std::try_to_lock);
+                if (!locks.back())
+                    return false;
+            }
+        }
+
+        // a tile may still be pinned meanwhile, so they're erased from the top down: the ones
+        // erased before it then don't leave a tile without the children it split into
+        std::size_t erased = 0;
+        for (auto it = evicted.rbegin(); it != evicted.rend() && eraseTile(*it, true); ++it) {
+            cache.remove(*it);
+            erased++;
+        }
+        GEOJSONVT_COUNT(Counter::evicted_tiles, erased);
+        return erased == evicted.size();
+    }
+
+    // the fixed-point grid of the options, see Options::fixedPoint
+    double grid() const {
+        return detail::fixedGrid(options);
+    }
+
+    double tileTolerance(const uint8_t z) const {
+        const double z2 = 1u << z;
+        return z == options.maxZoom ? 0 : options.tolerance / (z2 * options.extent);
+    }
+
+    // tiles are counted before they're stored, since other threads may change them right after
+    void addTile(InternalTile&& tile) {
+        const uint8_t z = tile.z;
+        account(tile);
+        tiles.emplace(toID(z, tile.x, tile.y), std::move(tile));
+        tileCounts.at(z)++;
+        total++;
+    }
+
+    // counts what a tile holds now in the memory usage of its zoom, instead of what it held when
+    // it last changed; the tile's drill lock is held, or no other thread calls getTile
+    void account(const InternalTile& tile) const {
+        MemoryUsage usage = tile.memoryUsage();
+        usage.tables = TileTable::node_bytes;
+        memory.at(tile.z).update(tile.counted, usage);
+        tile.counted = usage;
+    }
+
+    // erases a stored tile, which then no longer counts; with `skipPinned`, a tile some thread
+    // has pinned is kept instead. The same locking as for `account` applies
+    bool eraseTile(const uint64_t id, const bool skipPinned = false) {
+        return tiles.eraseUnless(id, [&](const InternalTile& tile) {
+            if (skipPinned && pins.contains(id))
+                return true;
+            memory.at(tile.z).update(tile.counted, {});
+            return false;
+        });
+    }
+
+    InternalTile*
+    findParent(const uint8_t z, const uint32_t x, const uint32_t y, uint64_t& parentID) {
+        uint8_t z0 = z;
+        uint32_t x0 = x;
+        uint32_t y0 = y;
+
+        InternalTile* parent = nullptr;
+
+        while (!parent && (z0 != 0)) {
+            z0--;
+            x0 = x0 / 2;
+            y0 = y0 / 2;
+            parentID = toID(z0, x0, y0);
+            parent = findTile(parentID);
+        }
+
+        return parent;
+    }
+
+    // tiles `features` below `tile`, appending the new tiles to `built` in depth-first order;
+    // cz/cx/cy is the target of a drill-down, or zero for the first-pass tiling, in which
+    // the children of tiles above `forkZoom` are tiled as separate tasks on `pool`
+    //
+    // the features are moved into the tiles that stop tiling, and clipped to the children
+    // otherwise, so no tile copies the features it's given
+    void splitTile(detail::vt_features features,
+                   InternalTile& tile,
+                   const uint8_t cz,
+                   const uint32_t cx,
+                   const uint32_t cy,
+                   std::deque<InternalTile>& built,
+                   detail::ThreadPool* pool = nullptr,
+                   const uint8_t forkZoom = 0) const {
+
+        const uint8_t z = tile.z;
+        const uint32_t x = tile.x;
+        const uint32_t y = tile.y;
 
         if (features.empty())
             return;
 
-        // stop tiling if the tile is solid clipped square
-        if (!options.solidChildren && tile.is_solid)
+        // stop tiling if the tile is solid clipped square; its source features are kept in case
+        // an update makes it not solid anymore
+        if (!options.solidChildren && tile.is_solid) {
+            keepFeatures(tile, std::move(features));
             return;
+        }
 
         // if it's the first-pass tiling
         if (cz == 0u) {
             // stop tiling if we reached max zoom, or if the tile is too simple
             if (z == options.indexMaxZoom || tile.tile.num_points <= options.indexMaxPoints) {
-                tile.source_features = features;
+                keepFeatures(tile, std::move(features));
                 return;
             }
 
         } else { // drilldown to a specific tile;
             // stop tiling if we reached base zoom
-            if (z == options.maxZoom)
+            if (z == options.maxZoom) {
+                tile.keepPending(features);
                 return;
+            }
 
             // stop tiling if it's our target tile zoom
             if (z == cz) {
-                tile.source_features = features;
+                keepFeatures(tile, std::move(features));
                 return;
             }
 
@@ -211,34 +1589,179 @@ private:
             const double m = 1u << (cz - z);
             if (x != static_cast<uint32_t>(std::floor(cx / m)) ||
                 y != static_cast<uint32_t>(std::floor(cy / m))) {
-                tile.source_features = features;
+                keepFeatures(tile, std::move(features));
                 return;
             }
         }
 
-        const double p = 0.5 * options.buffer / options.extent;
-        const auto& min = tile.bbox.min;
-        const auto& max = tile.bbox.max;
+        // if we sliced further down, no need to keep source geometry
+        tile.keepPending(features);
+        splitChildren(std::move(features), tile, cz, cx, cy, built, pool, forkZoom);
+    }
 
-        const auto left = detail::clip<0>(features, (x - p) / z2, (x + 0.5 + p) / z2, min.x, max.x);
+    // tiles that stop tiling keep their features to drill down from, without the spare capacity
+    // that consuming clips leave behind
+    static void keepFeatures(InternalTile& tile, detail::vt_features&& features) {
+        tile.source_features = std::move(features);
+        tile.source_features.shrink_to_fit();
+    }
 
-        splitTile(detail::clip<1>(left, (y - p) / z2, (y + 0.5 + p) / z2, min.y, max.y), z + 1,
-                  x * 2, y * 2, cz, cx, cy);
-        splitTile(detail::clip<1>(left, (y + 0.5 - p) / z2, (y + 1 + p) / z2, min.y, max.y), z + 1,
-                  x * 2, y * 2 + 1, cz, cx, cy);
+    // clips `features` to the four children of `tile` and tiles them; the features are consumed
+    // when they're passed as an rvalue, and only read otherwise, e.g. when drilling down from a
+    // tile that keeps its own
+    template <class Features>
+    void splitChildren(Features&& features,
+                       const InternalTile& tile,
+                       const uint8_t cz,
+                       const uint32_t cx,
+                       const uint32_t cy,
+                       std::deque<InternalTile>& built,
+                       detail::ThreadPool* pool = nullptr,
+                       const uint8_t forkZoom = 0) const {
+        const uint8_t z = tile.z;
+        const uint32_t x = tile.x;
+        const uint32_t y = tile.y;
 
-        const auto right =
-            detail::clip<0>(features, (x + 0.5 - p) / z2, (x + 1 + p) / z2, min.x, max.x);
+        auto children = clipChildren(std::forward<Features>(features), z, x, y, tile.bbox);
 
-        splitTile(detail::clip<1>(right, (y - p) / z2, (y + 0.5 + p) / z2, min.y, max.y), z + 1,
-                  x * 2 + 1, y * 2, cz, cx, cy);
-        splitTile(detail::clip<1>(right, (y + 0.5 - p) / z2, (y + 1 + p) / z2, min.y, max.y), z + 1,
-                  x * 2 + 1, y * 2 + 1, cz, cx, cy);
+        if (!pool || z >= forkZoom) {
+            for (uint8_t i = 0; i < 4; ++i) {
+                splitChild(std::move(children[i]), z + 1, x * 2 + i / 2, y * 2 + i % 2, cz, cx,
+                           cy, built, pool, forkZoom);
+            }
 
-        // if we sliced further down, no need to keep source geometry
-        tile.source_features = {};
+        } else {
+            // each subtree collects its own tiles, appended in order once all are done
+            std::array<std::deque<InternalTile>, 4> subtrees;
+            std::vector<std::future<void>> tasks;
+            for (uint8_t i = 0; i < 4; ++i) {
+                tasks.push_back(pool->push([&, i] {
+                    this->splitChild(std::move(children[i]), z + 1, x * 2 + i / 2, y * 2 + i % 2,
+                                     cz, cx, cy, subtrees[i], pool, forkZoom);
+                    detail::scratchArena().release();
+                }));
+            }
+            pool->wait(tasks);
+
+            for (auto& subtree : subtrees) {
+                std::move(subtree.begin(), subtree.end(), std::back_inserter(built));
+            }
+        }
+    }
+
+    // clips features covering `bbox` to the children of tile z/x/y, in the order
+    // (2x, 2y), (2x, 2y + 1), (2x + 1, 2y), (2x + 1, 2y + 1); rvalue features are freed once
+    // they're split, before the children are tiled
+    template <class Features>
+    std::array<detail::vt_features, 4> clipChildren(Features&& features,
+                                                    const uint8_t z,
+                                                    const uint32_t x,
+                                                    const uint32_t y,
+                                                    const mapbox::geometry::box<double>& bbox) const {
+        auto children = detail::splitQuadrants(features, childBounds(z, x), childBounds(z, y),
+                                               bbox, 0xf, grid());
+        release(std::forward<Features>(features));
+        return children;
+    }
+
+    // drills down from a tile keeping many source features to cz/cx/cy by building just the
+    // tiles on the way there, starting from the features the tile's spatial index finds near
+    // the first of them; their siblings aren't built, so they keep their source features to be
+    // drilled down from later. The drill lock of the tile is held, so the index is built here
+    // on first use
+    void drillIndexed(InternalTile& tile,
+                      const uint8_t cz,
+                      const uint32_t cx,
+                      const uint32_t cy,
+                      std::deque<InternalTile>& built) const {
+        if (!tile.feature_index)
+            tile.feature_index = std::make_unique<const detail::FeatureIndex>(tile.source_features);
+
+        const InternalTile* parent = &tile;
+        while (true) {
+            const uint8_t z = parent->z + 1;
+            const uint32_t x = cx >> (cz - z);
+            const uint32_t y = cy >> (cz - z);
+            // siblings of an evicted tile may still be cached when drilling down to it again
+            if (hasTile(toID(z, x, y)))
+                return;
+
+            const uint8_t i = (x & 1) * 2 + (y & 1);
+            const auto xs = childBounds(parent->z, parent->x);
+            const auto ys = childBounds(parent->z, parent->y);
+            detail::vt_features features;
+            if (parent == &tile) {
+                // the features not found can only be rejected by the child's column or row, so
+                // splitting the rest against the tile's bbox gives the child the same features
+                detail::vt_features nearby;
+                for (const uint32_t j : tile.feature_index->query(
+                         { { xs[i / 2][0], ys[i % 2][0] }, { xs[i / 2][1], ys[i % 2][1] } })) {
+                    nearby.push_back(tile.source_features[j]);
+                }
+                features = std::move(
+                    detail::splitQuadrants(nearby, xs, ys, tile.bbox, 1u << i, grid())[i]);
+            } else {
+                features = std::move(detail::splitQuadrants(parent->source_features, xs, ys,
+                                                            parent->bbox, 1u << i, grid())[i]);
+            }
+
+            // the same stops as splitTile's for the tiles on the way
+            built.emplace_back(features, z, x, y, options.extent, options.buffer,
+                               tileTolerance(z), options.lazyTiles, options.maxPointsPerTile,
+                               detail::sourceTolerance(options), grid());
+            auto& child = built.back();
+            if (features.empty())
+                return;
+            if (z == options.maxZoom) {
+                child.keepPending(features);
+                return;
+            }
+            keepFeatures(child, std::move(features));
+            if ((!options.solidChildren && child.is_solid) || z == cz)
+                return;
+            parent = &child;
+        }
+    }
+
+    // the bounds of the two columns or rows of tile z/k's children, where k is the tile's x or y
+    detail::split_bounds childBounds(const uint8_t z, const uint32_t k) const {
+        const double z2 = 1u << z;
+        const double p = 0.5 * options.buffer / options.extent;
+        return { { { (k - p) / z2, (k + 0.5 + p) / z2 },
+                   { (k + 0.5 - p) / z2, (k + 1 + p) / z2 } } };
+    }
+
+    static void release(detail::vt_features&& features) {
+        detail::vt_features().swap(features);
+    }
+
+    static void release(const detail::vt_features&) {
+    }
+
+    void splitChild(detail::vt_features features,
+                    const uint8_t z,
+                    const uint32_t x,
+                    const uint32_t y,
+                    const uint8_t cz,
+                    const uint32_t cx,
+                    const uint32_t cy,
+                    std::deque<InternalTile>& built,
+                    detail::ThreadPool* pool,
+                    const uint8_t forkZoom) const {
+        // siblings of an evicted tile may still be cached when drilling down to it again
+        if (cz != 0u && hasTile(toID(z, x, y)))
+            return;
+
+        built.emplace_back(features, z, x, y, options.extent, options.buffer, tileTolerance(z),
+                           options.lazyTiles, options.maxPointsPerTile,
+                           detail::sourceTolerance(options), grid());
+        // printf("tile z%i-%i-%i\n", z, x, y);
+        splitTile(std::move(features), built.back(), cz, cx, cy, built, pool, forkZoom);
     }
 };
 
+// the default tiles, with the 16-bit coordinates vector tiles are usually encoded from
+using GeoJSONVT = BasicGeoJSONVT<int16_t>;
+
 } // namespace geojsonvt
 } // namespace mapbox
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+/* bump allocator for the temporaries of clipping and simplifying, i.e. slice and ring buffers,
+ * packed coordinates and range stacks; they're freed in the reverse order they're allocated in
+ * by rewinding to a mark (see ArenaScope), so allocating is a pointer bump and freeing is free,
+ * and the blocks are kept for the next ones until `release`, which frees all but `retained`
+ * bytes of them once the arena is empty again; the index releases a thread's arena when it's
+ * done with a build or a drill-down, so that a thread doesn't hold on to the scratch of the
+ * largest geometry it ever clipped, but doesn't map and fault in small blocks for every call
+ */
+class Arena {
+public:
+    static constexpr std::size_t block_size = 64 * 1024;
+    static constexpr std::size_t retained = 1024 * 1024;
+
+    struct Mark {
+        std::size_t block;
+        std::size_t used;
+    };
+
+    void* allocate(const std::size_t bytes, const std::size_t align) {
+        while (current < blocks.size()) {
+            const std::size_t offset = (used + align - 1) & ~(align - 1);
+            if (offset + bytes <= blocks[current].size) {
+                used = offset + bytes;
+                return blocks[current].data.get() + offset;
+            }
+            // the rest of a block a buffer doesn't fit in stays unused until it's rewound
+            ++current;
+            used = 0;
+        }
+        // blocks come from new[], which aligns them for any type
+        const std::size_t size = bytes > block_size ? bytes : block_size;
+        blocks.push_back({ std::unique_ptr<char[]>(new char[size]), size });
+        used = bytes;
+        return blocks.back().data.get();
+    }
+
+    Mark mark() const {
+        return { current, used };
+    }
+
+    void rewind(const Mark& mark) {
+        current = mark.block;
+        used = mark.used;
+    }
+
+    // frees the blocks over `retained` bytes, the last ones first, if nothing is allocated from
+    // them anymore
+    void release(const std::size_t keep = retained) {
+        if (current != 0 || used != 0)
+            return;
+        std::size_t bytes = capacity();
+        while (bytes > keep) {
+            bytes -= blocks.back().size;
+            blocks.pop_back();
+        }
+    }
+
+    std::size_t capacity() const {
+        std::size_t bytes = 0;
+        for (const auto& block : blocks) {
+            bytes += block.size;
+        }
+        return bytes;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        std::size_t size;
+    };
+
+    std::vector<Block> blocks;
+    std::size_t current = 0;
+    std::size_t used = 0;
+};
+
+// the arena of the calling thread
+inline Arena& scratchArena() {
+    thread_local Arena arena;
+    return arena;
+}
+
+// frees what's allocated from the arena while it's alive
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena& arena_) : arena(arena_), start(arena_.mark()) {
+    }
+    ~ArenaScope() {
+        arena.rewind(start);
+    }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    Arena& arena;
+    const Arena::Mark start;
+};
+
+// a standard allocator over an arena, for containers that don't outlive the enclosing scope;
+// memory is only ever given back by rewinding
+template <class T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    Arena* arena;
+
+    explicit ArenaAllocator(Arena& arena_) : arena(&arena_) {
+    }
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {
+    }
+
+    T* allocate(const std::size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, std::size_t) {
+    }
+};
+
+template <class T, class U>
+inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena == b.arena;
+}
+template <class T, class U>
+inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena != b.arena;
+}
+
+template <class T>
+using arena_vector = std::vector<T, ArenaAllocator<T>>;
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <mapbox/geojsonvt/arena.hpp>
+#include <mapbox/geojsonvt/profile.hpp>
+#include <mapbox/geojsonvt/scan.hpp>
 #include <mapbox/geojsonvt/types.hpp>
 
+#include <array>
+#include <vector>
+
 namespace mapbox {
 namespace geojsonvt {
 namespace detail {
@@ -11,6 +17,8 @@ class clipper {
 public:
     const double k1;
     const double k2;
+    // the fixed-point grid intersections are snapped to, see Options::fixedPoint (0 for none)
+    const double grid = 0;
 
     vt_geometry operator()(const vt_point& point) const {
         return point;
@@ -30,7 +38,7 @@ public:
         vt_multi_line_string parts;
         clipLine(line, parts);
         if (parts.size() == 1)
-            return parts[0];
+            return std::move(parts[0]);
         else
             return parts;
     }
@@ -41,17 +49,18 @@ public:
             clipLine(line, parts);
         }
         if (parts.size() == 1)
-            return parts[0];
+            return std::move(parts[0]);
         else
             return parts;
     }
 
     vt_geometry operator()(const vt_polygon& polygon) const {
         vt_polygon result;
+        result.reserve(polygon.size());
         for (const auto& ring : polygon) {
-            const auto new_ring = clipRing(ring);
+            auto new_ring = clipRing(ring);
             if (!new_ring.empty())
-                result.push_back(new_ring);
+                result.push_back(std::move(new_ring));
         }
         return result;
     }
@@ -60,13 +69,14 @@ public:
         vt_multi_polygon result;
         for (const auto& polygon : polygons) {
             vt_polygon p;
+            p.reserve(polygon.size());
             for (const auto& ring : polygon) {
-                const auto new_ring = clipRing(ring);
+                auto new_ring = clipRing(ring);
                 if (!new_ring.empty())
-                    p.push_back(new_ring);
+                    p.push_back(std::move(new_ring));
             }
             if (!p.empty())
-                result.push_back(p);
+                result.push_back(std::move(p));
         }
         return result;
     }
@@ -81,12 +91,37 @@ public:
     }
 
 private:
-    vt_line_string newSlice(vt_multi_line_string& parts, vt_line_string& slice, double dist) const {
+    // slices and rings are built in a buffer from the thread's scratch arena and then copied out
+    // at their final size, so clipping allocates once per output container; the buffer has room
+    // for the input and a closing point, and grows in the arena in the rare cases crossings take
+    // more than that
+    static arena_vector<vt_point> scratch(const std::size_t len) {
+        arena_vector<vt_point> buffer{ ArenaAllocator<vt_point>(scratchArena()) };
+        buffer.reserve(len + 2);
+        return buffer;
+    }
+
+    // the point where a-b crosses k, which is on the grid already when k is a tile edge
+    vt_point cut(const vt_point& a, const vt_point& b, const double k) const {
+        auto p = intersect<I>(a, b, k);
+        if (I == 0)
+            p.y = snapToGrid(p.y, grid);
+        else
+            p.x = snapToGrid(p.x, grid);
+        return p;
+    }
+
+    bool isInside(const vt_point& p) const {
+        const double k = get<I>(p);
+        return !(k < k1) && !(k > k2);
+    }
+
+    void newSlice(vt_multi_line_string& parts, arena_vector<vt_point>& slice, double dist) const {
         if (!slice.empty()) {
-            slice.dist = dist;
-            parts.push_back(std::move(slice));
+            parts.emplace_back(slice.begin(), slice.end());
+            parts.back().dist = dist;
+            slice.clear();
         }
-        return {};
     }
 
     void clipLine(const vt_line_string& line, vt_multi_line_string& slices) const {
@@ -97,9 +132,22 @@ private:
         if (len < 2)
             return;
 
-        vt_line_string slice;
+        const ArenaScope scope(scratchArena());
+        auto slice = scratch(len);
 
         for (size_t i = 0; i < (len - 1); ++i) {
+            if (isInside(line[i])) {
+                // copy the run of segments that stay inside at once, ending on the first segment
+                // that leaves; each of them adds its start point, and the last one its end too
+                const size_t run = countInside<I>(&line[i + 1], len - i - 1, k1, k2);
+                if (run == len - i - 1) {
+                    slice.insert(slice.end(), line.begin() + i, line.end());
+                    break;
+                }
+                slice.insert(slice.end(), line.begin() + i, line.begin() + i + run);
+                i += run;
+            }
+
             const auto& a = line[i];
             const auto& b = line[i + 1];
             const double ak = get<I>(a);
@@ -107,23 +155,23 @@ private:
 
             if (ak < k1) {
                 if (bk > k2) { // ---|-----|-->
-                    slice.push_back(intersect<I>(a, b, k1));
-                    slice.push_back(intersect<I>(a, b, k2));
-                    slice = newSlice(slices, slice, dist);
+                    slice.push_back(cut(a, b, k1));
+                    slice.push_back(cut(a, b, k2));
+                    newSlice(slices, slice, dist);
 
                 } else if (bk >= k1) { // ---|-->  |
-                    slice.push_back(intersect<I>(a, b, k1));
+                    slice.push_back(cut(a, b, k1));
                     if (i == len - 2)
                         slice.push_back(b); // last point
                 }
             } else if (ak > k2) {
                 if (bk < k1) { // <--|-----|---
-                    slice.push_back(intersect<I>(a, b, k2));
-                    slice.push_back(intersect<I>(a, b, k1));
-                    slice = newSlice(slices, slice, dist);
+                    slice.push_back(cut(a, b, k2));
+                    slice.push_back(cut(a, b, k1));
+                    newSlice(slices, slice, dist);
 
                 } else if (bk <= k2) { // |  <--|---
-                    slice.push_back(intersect<I>(a, b, k2));
+                    slice.push_back(cut(a, b, k2));
                     if (i == len - 2)
                         slice.push_back(b); // last point
                 }
@@ -131,12 +179,12 @@ private:
                 slice.push_back(a);
 
                 if (bk < k1) { // <--|---  |
-                    slice.push_back(intersect<I>(a, b, k1));
-                    slice = newSlice(slices, slice, dist);
+                    slice.push_back(cut(a, b, k1));
+                    newSlice(slices, slice, dist);
 
                 } else if (bk > k2) { // |  ---|-->
-                    slice.push_back(intersect<I>(a, b, k2));
-                    slice = newSlice(slices, slice, dist);
+                    slice.push_back(cut(a, b, k2));
+                    newSlice(slices, slice, dist);
 
                 } else if (i == len - 2) { // | --> |
                     slice.push_back(b);
@@ -151,13 +199,27 @@ private:
     vt_linear_ring clipRing(const vt_linear_ring& ring) const {
         const size_t len = ring.size();
 
-        vt_linear_ring slice;
-        slice.area = ring.area;
+        vt_linear_ring result;
+        result.area = ring.area;
 
         if (len < 2)
-            return slice;
+            return result;
+
+        const ArenaScope scope(scratchArena());
+        auto slice = scratch(len);
 
         for (size_t i = 0; i < (len - 1); ++i) {
+            if (isInside(ring[i])) {
+                // copy the run of segments that stay inside at once, each adding its start point
+                const size_t run = countInside<I>(&ring[i + 1], len - i - 1, k1, k2);
+                if (run == len - i - 1) {
+                    slice.insert(slice.end(), ring.begin() + i, ring.end() - 1);
+                    break;
+                }
+                slice.insert(slice.end(), ring.begin() + i, ring.begin() + i + run);
+                i += run;
+            }
+
             const auto& a = ring[i];
             const auto& b = ring[i + 1];
             const double ak = get<I>(a);
@@ -165,26 +227,26 @@ private:
 
             if (ak < k1) {
                 if (bk >= k1) {
-                    slice.push_back(intersect<I>(a, b, k1)); // ---|-->  |
+                    slice.push_back(cut(a, b, k1)); // ---|-->  |
                     if (bk > k2)                             // ---|-----|-->
-                        slice.push_back(intersect<I>(a, b, k2));
+                        slice.push_back(cut(a, b, k2));
                     else if (i == len - 2)
                         slice.push_back(b); // last point
                 }
             } else if (ak > k2) {
                 if (bk <= k2) { // |  <--|---
-                    slice.push_back(intersect<I>(a, b, k2));
+                    slice.push_back(cut(a, b, k2));
                     if (bk < k1) // <--|-----|---
-                        slice.push_back(intersect<I>(a, b, k1));
+                        slice.push_back(cut(a, b, k1));
                     else if (i == len - 2)
                         slice.push_back(b); // last point
                 }
             } else {
                 slice.push_back(a);
                 if (bk < k1) // <--|---  |
-                    slice.push_back(intersect<I>(a, b, k1));
+                    slice.push_back(cut(a, b, k1));
                 else if (bk > k2) // |  ---|-->
-                    slice.push_back(intersect<I>(a, b, k2));
+                    slice.push_back(cut(a, b, k2));
                 // | --> |
             }
         }
@@ -198,10 +260,23 @@ private:
             }
         }
 
-        return slice;
+        result.assign(slice.begin(), slice.end());
+        return result;
     }
 };
 
+// a feature that crosses the clip bounds, cut to them
+template <uint8_t I>
+inline vt_feature
+clipFeature(const vt_feature& feature, const double k1, const double k2, const double grid = 0) {
+    vt_feature clipped(vt_geometry::visit(*feature.geometry, clipper<I>{ k1, k2, grid }),
+                       feature.properties, feature.id);
+    GEOJSONVT_COUNT(Counter::clip_features_clipped, 1);
+    GEOJSONVT_COUNT(Counter::clip_points_in, countPoints(*feature.geometry));
+    GEOJSONVT_COUNT(Counter::clip_points_out, countPoints(*clipped.geometry));
+    return clipped;
+}
+
 /* clip features between two axis-parallel lines:
  *     |        |
  *  ___|___     |     /
@@ -214,38 +289,174 @@ inline vt_features clip(const vt_features& features,
                         const double k1,
                         const double k2,
                         const double minAll,
-                        const double maxAll) {
+                        const double maxAll,
+                        const double grid = 0) {
+    GEOJSONVT_TIME(I == 0 ? Counter::clip_x_calls : Counter::clip_y_calls);
 
-    if (minAll >= k1 && maxAll <= k2) // trivial accept
+    if (minAll >= k1 && maxAll <= k2) { // trivial accept
+        GEOJSONVT_COUNT(Counter::clip_trivial_accepts, 1);
         return features;
+    }
 
-    if (minAll > k2 || maxAll < k1) // trivial reject
+    if (minAll > k2 || maxAll < k1) { // trivial reject
+        GEOJSONVT_COUNT(Counter::clip_trivial_rejects, 1);
         return {};
+    }
 
     vt_features clipped;
 
     for (const auto& feature : features) {
-        const auto& geom = feature.geometry;
-        const auto& props = feature.properties;
-        const auto& id = feature.id;
-
         const double min = get<I>(feature.bbox.min);
         const double max = get<I>(feature.bbox.max);
 
         if (min >= k1 && max <= k2) { // trivial accept
+            GEOJSONVT_COUNT(Counter::clip_feature_accepts, 1);
             clipped.push_back(feature);
 
         } else if (min > k2 || max < k1) { // trivial reject
+            GEOJSONVT_COUNT(Counter::clip_feature_rejects, 1);
             continue;
 
         } else {
-            clipped.emplace_back(vt_geometry::visit(geom, clipper<I>{ k1, k2 }), props, id);
+            clipped.push_back(clipFeature<I>(feature, k1, k2, grid));
         }
     }
 
     return clipped;
 }
 
+// the same, reusing the storage of `features`: features that are kept are moved into place instead
+// of copied, so only the geometry that's cut allocates
+template <uint8_t I>
+inline vt_features clip(vt_features&& features,
+                        const double k1,
+                        const double k2,
+                        const double minAll,
+                        const double maxAll,
+                        const double grid = 0) {
+    GEOJSONVT_TIME(I == 0 ? Counter::clip_x_calls : Counter::clip_y_calls);
+
+    if (minAll >= k1 && maxAll <= k2) { // trivial accept
+        GEOJSONVT_COUNT(Counter::clip_trivial_accepts, 1);
+        return std::move(features);
+    }
+
+    if (minAll > k2 || maxAll < k1) { // trivial reject
+        GEOJSONVT_COUNT(Counter::clip_trivial_rejects, 1);
+        return {};
+    }
+
+    auto kept = features.begin();
+
+    for (auto& feature : features) {
+        const double min = get<I>(feature.bbox.min);
+        const double max = get<I>(feature.bbox.max);
+
+        if (min >= k1 && max <= k2) { // trivial accept
+            GEOJSONVT_COUNT(Counter::clip_feature_accepts, 1);
+            if (&*kept != &feature)
+                *kept = std::move(feature);
+            ++kept;
+
+        } else if (min > k2 || max < k1) { // trivial reject
+            GEOJSONVT_COUNT(Counter::clip_feature_rejects, 1);
+
+        } else {
+            vt_feature clipped(vt_geometry::visit(*feature.geometry, clipper<I>{ k1, k2, grid }),
+                               std::move(feature.properties), feature.id);
+            GEOJSONVT_COUNT(Counter::clip_features_clipped, 1);
+            GEOJSONVT_COUNT(Counter::clip_points_in, countPoints(*feature.geometry));
+            GEOJSONVT_COUNT(Counter::clip_points_out, countPoints(*clipped.geometry));
+            *kept++ = std::move(clipped);
+        }
+    }
+
+    features.erase(kept, features.end());
+    return std::move(features);
+}
+
+// the bounds of a tile's two columns or rows, each overlapping the middle by the buffer
+using split_bounds = std::array<std::array<double, 2>, 2>;
+
+/* split features into the four quadrants of a tile in one pass over them, in the order
+ * (left, top), (left, bottom), (right, top), (right, bottom); each quadrant gets exactly what
+ * clipping to its column with clip<0> and then to its row with clip<1> would give, without
+ * building the column strips in between: features inside a column or row go straight to the
+ * quadrants, and a feature crossing the middle column line is cut once for both of its rows
+ *
+ * `wanted` has a bit for each quadrant in that order, the others are left empty; `grid` is
+ * passed on to the clipper
+ */
+inline std::array<vt_features, 4> splitQuadrants(const vt_features& features,
+                                                const split_bounds& xs,
+                                                const split_bounds& ys,
+                                                const mapbox::geometry::box<double>& bbox,
+                                                const uint8_t wanted = 0xf,
+                                                const double grid = 0) {
+    GEOJSONVT_TIME(Counter::split_calls);
+
+    // whether all of the features are inside or outside each column and row, as clip checks for
+    // the whole set; accepting comes first, as the empty box of a tile with only empty features
+    // is both
+    bool accepts[2][2];
+    bool rejects[2][2];
+    for (uint8_t i = 0; i < 2; ++i) {
+        accepts[0][i] = bbox.min.x >= xs[i][0] && bbox.max.x <= xs[i][1];
+        rejects[0][i] = !accepts[0][i] && (bbox.min.x > xs[i][1] || bbox.max.x < xs[i][0]);
+        accepts[1][i] = bbox.min.y >= ys[i][0] && bbox.max.y <= ys[i][1];
+        rejects[1][i] = !accepts[1][i] && (bbox.min.y > ys[i][1] || bbox.max.y < ys[i][0]);
+        GEOJSONVT_COUNT(Counter::clip_trivial_accepts, accepts[0][i] + 2 * accepts[1][i]);
+        GEOJSONVT_COUNT(Counter::clip_trivial_rejects, rejects[0][i] + 2 * rejects[1][i]);
+    }
+
+    std::array<vt_features, 4> quadrants;
+    if (features.empty())
+        return quadrants;
+
+    for (const auto& feature : features) {
+        for (uint8_t i = 0; i < 2; ++i) {
+            if (rejects[0][i] || !((wanted >> (i * 2)) & 3))
+                continue;
+
+            optional<vt_feature> cut;
+            if (!accepts[0][i]) {
+                const double k1 = xs[i][0];
+                const double k2 = xs[i][1];
+                if (feature.bbox.min.x >= k1 && feature.bbox.max.x <= k2) {
+                    GEOJSONVT_COUNT(Counter::clip_feature_accepts, 1);
+                } else if (feature.bbox.min.x > k2 || feature.bbox.max.x < k1) {
+                    GEOJSONVT_COUNT(Counter::clip_feature_rejects, 1);
+                    continue;
+                } else {
+                    cut = clipFeature<0>(feature, k1, k2, grid);
+                }
+            }
+            const vt_feature& column = cut ? *cut : feature;
+
+            for (uint8_t j = 0; j < 2; ++j) {
+                if (rejects[1][j] || !((wanted >> (i * 2 + j)) & 1))
+                    continue;
+
+                auto& quadrant = quadrants[i * 2 + j];
+                const double k1 = ys[j][0];
+                const double k2 = ys[j][1];
+                if (accepts[1][j]) {
+                    quadrant.push_back(column);
+                } else if (column.bbox.min.y >= k1 && column.bbox.max.y <= k2) {
+                    GEOJSONVT_COUNT(Counter::clip_feature_accepts, 1);
+                    quadrant.push_back(column);
+                } else if (column.bbox.min.y > k2 || column.bbox.max.y < k1) {
+                    GEOJSONVT_COUNT(Counter::clip_feature_rejects, 1);
+                } else {
+                    quadrant.push_back(clipFeature<1>(column, k1, k2, grid));
+                }
+            }
+        }
+    }
+
+    return quadrants;
+}
+
 } // namespace detail
 } // namespace geojsonvt
 } // namespace mapbox
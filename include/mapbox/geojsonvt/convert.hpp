@@ -1,11 +1,17 @@
 #pragma once
 
+#include <mapbox/geojsonvt/profile.hpp>
+#include <mapbox/geojsonvt/properties.hpp>
 #include <mapbox/geojsonvt/simplify.hpp>
+#include <mapbox/geojsonvt/thread_pool.hpp>
 #include <mapbox/geojsonvt/types.hpp>
 #include <mapbox/geometry.hpp>
 
 #include <algorithm>
 #include <cmath>
+#include <future>
+#include <iterator>
+#include <vector>
 
 namespace mapbox {
 namespace geojsonvt {
@@ -13,6 +19,10 @@ namespace detail {
 
 struct project {
     const double tolerance;
+    // whether lines and rings are simplified with monotone importance, see simplify
+    const bool monotone = false;
+    // the fixed-point grid the projected points are snapped to, see Options::fixedPoint
+    const double grid = 0;
     using result_type = vt_geometry;
 
     vt_point operator()(const geometry::point<double>& p) {
@@ -20,7 +30,7 @@ struct project {
         const double x = p.x / 360 + 0.5;
         const double y =
             std::max(std::min(0.5 - 0.25 * std::log((1 + sine) / (1 - sine)) / M_PI, 1.0), 0.0);
-        return { x, y, 0.0 };
+        return { snapToGrid(x, grid), snapToGrid(y, grid), 0.0 };
     }
 
     vt_line_string operator()(const geometry::line_string<double>& points) {
@@ -44,7 +54,7 @@ struct project {
             result.dist += std::abs(b.x - a.x) + std::abs(b.y - a.y);
         }
 
-        simplify(result, tolerance);
+        simplify(result, tolerance, monotone);
 
         return result;
     }
@@ -71,13 +81,13 @@ struct project {
         }
         result.area = std::abs(area / 2);
 
-        simplify(result, tolerance);
+        simplify(result, tolerance, monotone);
 
         return result;
     }
 
     vt_geometry operator()(const geometry::geometry<double>& geometry) {
-        return geometry::geometry<double>::visit(geometry, project{ tolerance });
+        return geometry::geometry<double>::visit(geometry, project{ tolerance, monotone, grid });
     }
 
     // Handles polygon, multi_*, geometry_collection.
@@ -92,15 +102,91 @@ struct project {
     }
 };
 
+// projects and simplifies features one at a time, so callers can drop each source feature as
+// soon as it's added instead of holding the whole collection
+class Converter {
+public:
+    explicit Converter(const double tolerance_,
+                       const bool monotone_ = false,
+                       const double grid_ = 0)
+        : tolerance(tolerance_), monotone(monotone_), grid(grid_) {
+    }
+
+    void add(const geometry::geometry<double>& geom,
+             const property_map& props,
+             const optional<identifier>& id) {
+        features.emplace_back(
+            geometry::geometry<double>::visit(geom, project{ tolerance, monotone, grid }),
+            pool.intern(props), id);
+    }
+
+    void add(const geometry::feature<double>& feature) {
+        add(feature.geometry, feature.properties, feature.id);
+    }
+
+    void reserve(const std::size_t size) {
+        features.reserve(size);
+    }
+
+    vt_features finish() {
+        pool = {};
+        scratchArena().release();
+        return std::move(features);
+    }
+
+private:
+    const double tolerance;
+    const bool monotone;
+    const double grid;
+    vt_features features;
+    PropertyPool pool;
+};
+
+inline vt_features convert(const geometry::feature_collection<double>& features,
+                           const double tolerance,
+                           const bool monotone = false,
+                           const double grid = 0) {
+    GEOJSONVT_TIME(Counter::convert_calls);
+    Converter converter(tolerance, monotone, grid);
+    converter.reserve(features.size());
+    for (const auto& feature : features) {
+        converter.add(feature);
+    }
+    return converter.finish();
+}
+
+// converts `chunks` consecutive ranges of features as separate tasks on `pool` and joins them in
+// order, so the result matches the serial conversion; each range interns its properties on its
+// own, so identical property maps are shared within a range only
 inline vt_features convert(const geometry::feature_collection<double>& features,
-                           const double tolerance) {
+                           const double tolerance,
+                           ThreadPool& pool,
+                           const std::size_t chunks,
+                           const bool monotone = false,
+                           const double grid = 0) {
+    GEOJSONVT_TIME(Counter::convert_calls);
+    const std::size_t size = std::max<std::size_t>((features.size() + chunks - 1) / chunks, 1);
+    std::vector<vt_features> converted((features.size() + size - 1) / size);
+
+    std::vector<std::future<void>> tasks;
+    for (std::size_t i = 0; i < converted.size(); ++i) {
+        tasks.push_back(pool.push([&, i] {
+            Converter converter(tolerance, monotone, grid);
+            const auto begin = features.begin() + i * size;
+            const auto end = features.begin() + std::min(features.size(), (i + 1) * size);
+            converter.reserve(end - begin);
+            for (auto it = begin; it != end; ++it) {
+                converter.add(*it);
+            }
+            converted[i] = converter.finish();
+        }));
+    }
+    pool.wait(tasks);
+
     vt_features projected;
     projected.reserve(features.size());
-    for (const auto& feature : features) {
-        projected.emplace_back(
-            geometry::geometry<double>::visit(feature.geometry, project{ tolerance }),
-            feature.properties,
-            feature.id);
+    for (auto& chunk : converted) {
+        std::move(chunk.begin(), chunk.end(), std::back_inserter(projected));
     }
     return projected;
 }
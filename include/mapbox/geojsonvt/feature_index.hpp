@@ -0,0 +1,189 @@
+#pragma once
+
+#include <mapbox/geojsonvt/types.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+/* a static packed R-tree over the boxes of a tile's features: the boxes are sorted along a
+ * Hilbert curve through their centers and packed bottom-up into nodes of `node_size` entries,
+ * each level stored after the one below it, so a query skips whole runs of features far
+ * from the bounds it asks for without looking at them
+ */
+
+class FeatureIndex {
+public:
+    static constexpr std::size_t node_size = 16;
+
+    explicit FeatureIndex(const vt_features& features) {
+        mapbox::geometry::box<double> extent = { { 2, 1 }, { -1, 0 } };
+        std::vector<uint32_t> order;
+        order.reserve(features.size());
+        for (uint32_t i = 0; i < features.size(); ++i) {
+            const auto& bbox = features[i].bbox;
+            // empty features have an inverted box and are only found by clip's accept check,
+            // which takes them all, so they're returned by every query
+            if (bbox.min.x > bbox.max.x) {
+                empty.push_back(i);
+                continue;
+            }
+            order.push_back(i);
+            extent.min.x = std::min(bbox.min.x, extent.min.x);
+            extent.min.y = std::min(bbox.min.y, extent.min.y);
+            extent.max.x = std::max(bbox.max.x, extent.max.x);
+            extent.max.y = std::max(bbox.max.y, extent.max.y);
+        }
+
+        const double width = extent.max.x - extent.min.x;
+        const double height = extent.max.y - extent.min.y;
+        std::vector<uint32_t> values(features.size());
+        for (const uint32_t i : order) {
+            const auto& bbox = features[i].bbox;
+            const double cx = (bbox.min.x + bbox.max.x) / 2 - extent.min.x;
+            const double cy = (bbox.min.y + bbox.max.y) / 2 - extent.min.y;
+            values[i] = hilbert(width > 0 ? static_cast<uint32_t>(0xffff * cx / width) : 0,
+                                height > 0 ? static_cast<uint32_t>(0xffff * cy / height) : 0);
+        }
+        std::sort(order.begin(), order.end(),
+                  [&](const uint32_t a, const uint32_t b) { return values[a] < values[b]; });
+
+        for (const uint32_t i : order) {
+            boxes.push_back(features[i].bbox);
+            entries.push_back(i);
+        }
+        levels.push_back(boxes.size());
+
+        // each node's box covers the entries of the level below it, which it points to by offset
+        std::size_t begin = 0;
+        while (boxes.size() - begin > 1) {
+            const std::size_t end = boxes.size();
+            for (std::size_t first = begin; first < end; first += node_size) {
+                const std::size_t last = std::min(first + node_size, end);
+                mapbox::geometry::box<double> node = boxes[first];
+                for (std::size_t j = first + 1; j < last; ++j) {
+                    node.min.x = std::min(boxes[j].min.x, node.min.x);
+                    node.min.y = std::min(boxes[j].min.y, node.min.y);
+                    node.max.x = std::max(boxes[j].max.x, node.max.x);
+                    node.max.y = std::max(boxes[j].max.y, node.max.y);
+                }
+                boxes.push_back(node);
+                entries.push_back(static_cast<uint32_t>(first));
+            }
+            levels.push_back(boxes.size());
+            begin = end;
+        }
+    }
+
+    // positions of the features whose boxes overlap `bounds`, edges included, and of the empty
+    // ones, in the order of the indexed features
+    std::vector<uint32_t> query(const mapbox::geometry::box<double>& bounds) const {
+        std::vector<uint32_t> result(empty);
+        if (boxes.empty())
+            return result;
+
+        // (first entry of a node, level of the node's entries) still to be visited
+        std::vector<std::pair<std::size_t, std::size_t>> stack;
+        stack.emplace_back(boxes.size() - 1, levels.size() - 1);
+        while (!stack.empty()) {
+            const std::size_t first = stack.back().first;
+            const std::size_t level = stack.back().second;
+            stack.pop_back();
+
+            const std::size_t last = std::min(first + node_size, levels[level]);
+            for (std::size_t i = first; i < last; ++i) {
+                const auto& box = boxes[i];
+                if (box.min.x > bounds.max.x || box.max.x < bounds.min.x ||
+                    box.min.y > bounds.max.y || box.max.y < bounds.min.y)
+                    continue;
+                if (level == 0)
+                    result.push_back(entries[i]);
+                else
+                    stack.emplace_back(entries[i], level - 1);
+            }
+        }
+
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // rough number of bytes the index holds
+    std::size_t bytes() const {
+        return boxes.capacity() * sizeof(mapbox::geometry::box<double>) +
+               (entries.capacity() + empty.capacity()) * sizeof(uint32_t) +
+               levels.capacity() * sizeof(std::size_t);
+    }
+
+private:
+    std::vector<mapbox::geometry::box<double>> boxes;
+    // a feature's position for the first level, the first entry of the level below for the rest
+    std::vector<uint32_t> entries;
+    // end of each level in `boxes`, from the features up to the root
+    std::vector<std::size_t> levels;
+    std::vector<uint32_t> empty;
+
+    // position of x, y on a Hilbert curve filling the 16-bit grid, from "Fast Hilbert curve
+    // generation, sorting, and range queries" by rawrunprotected
+    static uint32_t hilbert(uint32_t x, uint32_t y) {
+        uint32_t a = x ^ y;
+        uint32_t b = 0xFFFF ^ a;
+        uint32_t c = 0xFFFF ^ (x | y);
+        uint32_t d = x & (y ^ 0xFFFF);
+
+        uint32_t A = a | (b >> 1);
+        uint32_t B = (a >> 1) ^ a;
+        uint32_t C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+        uint32_t D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+        a = A;
+        b = B;
+        c = C;
+        d = D;
+        A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+        B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+        C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+        D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+        a = A;
+        b = B;
+        c = C;
+        d = D;
+        A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+        B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+        C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+        D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+        a = A;
+        b = B;
+        c = C;
+        d = D;
+        C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+        D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+        a = C ^ (C >> 1);
+        b = D ^ (D >> 1);
+
+        uint32_t i0 = x ^ y;
+        uint32_t i1 = b | (0xFFFF ^ (i0 | a));
+
+        i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+        i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+        i0 = (i0 | (i0 << 2)) & 0x33333333;
+        i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+        i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+        i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+        i1 = (i1 | (i1 << 2)) & 0x33333333;
+        i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+        return (i1 << 1) | i0;
+    }
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
@@ -0,0 +1,923 @@
+#pragma once
+
+#include <mapbox/geojsonvt/properties.hpp>
+#include <mapbox/geojsonvt/tile.hpp>
+#include <mapbox/geojsonvt/types.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GEOJSONVT_MMAP
+#endif
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+/* saved tile index layout, little-endian throughout:
+ *   "GJVT", format version (u32), tiling options and tile counts
+ *   tile records, each one self-contained
+ *   directory of (tile id, offset, size) sorted by tile id, 24 bytes per tile
+ *   directory offset (u64), tile count (u64), "GJVT"
+ * the directory is searched in place, so opening an index only reads the header and
+ * a tile is decoded the first time it's looked up
+ */
+
+constexpr char index_magic[4] = { 'G', 'J', 'V', 'T' };
+constexpr uint32_t index_version = 4;
+
+// tags the tile coordinate type an index was saved with: its size, plus 0x80 for floating point
+template <class T>
+constexpr uint8_t coordinateType() {
+    return static_cast<uint8_t>(sizeof(T) | (std::is_floating_point<T>::value ? 0x80 : 0));
+}
+
+struct IndexHeader {
+    uint8_t maxZoom = 0;
+    uint8_t indexMaxZoom = 0;
+    uint32_t indexMaxPoints = 0;
+    bool solidChildren = false;
+    double tolerance = 0;
+    uint32_t maxPointsPerTile = 0;
+    uint16_t extent = 0;
+    uint16_t buffer = 0;
+    uint8_t coordinates = 0;
+    // whether the geometry is on the grid of Options::fixedPoint
+    bool fixedPoint = false;
+
+    uint32_t total = 0;
+    std::vector<std::pair<uint8_t, uint32_t>> stats;
+};
+
+class ByteWriter {
+public:
+    std::string data;
+
+    void u8(const uint8_t value) {
+        data.push_back(static_cast<char>(value));
+    }
+    void u16(const uint16_t value) {
+        fixed(value, 2);
+    }
+    void u32(const uint32_t value) {
+        fixed(value, 4);
+    }
+    void u64(const uint64_t value) {
+        fixed(value, 8);
+    }
+    void f64(const double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        fixed(bits, 8);
+    }
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            data.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        data.push_back(static_cast<char>(value));
+    }
+    void svarint(const int64_t value) {
+        varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+    void string(const std::string& value) {
+        varint(value.size());
+        data += value;
+    }
+
+private:
+    void fixed(const uint64_t value, const int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            data.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+        }
+    }
+};
+
+class ByteReader {
+public:
+    ByteReader(const char* data_, const std::size_t size_) : data(data_), size(size_) {
+    }
+
+    uint8_t u8() {
+        return static_cast<uint8_t>(fixed(1));
+    }
+    uint16_t u16() {
+        return static_cast<uint16_t>(fixed(2));
+    }
+    uint32_t u32() {
+        return static_cast<uint32_t>(fixed(4));
+    }
+    uint64_t u64() {
+        return fixed(8);
+    }
+    double f64() {
+        const uint64_t bits = fixed(8);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const uint8_t byte = u8();
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("Invalid tile index: malformed varint");
+    }
+    int64_t svarint() {
+        const uint64_t value = varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+    std::string string() {
+        const auto length = varint();
+        need(length);
+        std::string value(data + pos, length);
+        pos += length;
+        return value;
+    }
+    // element counts are bounded by the remaining bytes, so a corrupt count can't make
+    // the reader reserve huge amounts of memory
+    std::size_t count() {
+        const auto value = varint();
+        need(value);
+        return static_cast<std::size_t>(value);
+    }
+
+    std::size_t position() const {
+        return pos;
+    }
+
+private:
+    const char* data;
+    std::size_t size;
+    std::size_t pos = 0;
+
+    void need(const uint64_t bytes) const {
+        if (bytes > size - pos)
+            throw std::runtime_error("Invalid tile index: unexpected end of data");
+    }
+
+    uint64_t fixed(const int bytes) {
+        need(bytes);
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(data[pos + i])) << (i * 8);
+        }
+        pos += bytes;
+        return value;
+    }
+};
+
+// writes tiles into records; nested property values can't be saved
+template <class T>
+class TileRecordWriter {
+public:
+    explicit TileRecordWriter(ByteWriter& out_) : out(out_) {
+    }
+
+    void write(const BasicInternalTile<T>& tile) {
+        write(tile, tile.source_features);
+    }
+
+    // `sources` stand in for the tile's source features, e.g. when they're kept in a spill
+    // file; lazy tiles are transformed first, so they're read back as they would be
+    void write(const BasicInternalTile<T>& tile, const vt_features& sources) {
+        tile.transform(sources);
+        out.u8(tile.is_solid ? 1 : 0);
+        out.f64(tile.bbox.min.x);
+        out.f64(tile.bbox.min.y);
+        out.f64(tile.bbox.max.x);
+        out.f64(tile.bbox.max.y);
+        out.varint(tile.tile.num_points);
+        out.varint(tile.tile.num_simplified);
+
+        out.varint(tile.tile.features.size());
+        for (const auto& feature : tile.tile.features) {
+            write(feature.geometry);
+            write(feature.properties);
+            write(feature.id);
+        }
+
+        out.varint(sources.size());
+        for (const auto& feature : sources) {
+            write(*feature.geometry);
+            write(*feature.properties);
+            write(feature.id);
+        }
+    }
+
+private:
+    ByteWriter& out;
+
+    void write(const property_map& properties) {
+        out.varint(properties.size());
+        for (const auto& property : properties) {
+            out.string(property.first);
+            mapbox::geometry::value::visit(property.second,
+                                           [&](const auto& v) { this->writeValue(v); });
+        }
+    }
+
+    void write(const optional<identifier>& id) {
+        if (!id) {
+            out.u8(0);
+            return;
+        }
+        identifier::visit(*id, [&](const auto& v) { this->writeValue(v); });
+    }
+
+    // property values and ids share their type tags
+    void writeValue(const mapbox::geometry::null_value_t&) {
+        out.u8(0);
+    }
+    void writeValue(const bool v) {
+        out.u8(1);
+        out.u8(v ? 1 : 0);
+    }
+    void writeValue(const uint64_t v) {
+        out.u8(2);
+        out.varint(v);
+    }
+    void writeValue(const int64_t v) {
+        out.u8(3);
+        out.svarint(v);
+    }
+    void writeValue(const double v) {
+        out.u8(4);
+        out.f64(v);
+    }
+    void writeValue(const std::string& v) {
+        out.u8(5);
+        out.string(v);
+    }
+    template <class U>
+    void writeValue(const U&) {
+        throw std::runtime_error("Can't save nested property values in a tile index");
+    }
+
+    // tile geometry
+    void write(const mapbox::geometry::geometry<T>& geometry) {
+        mapbox::geometry::geometry<T>::visit(geometry, [&](const auto& g) { this->writeTile(g); });
+    }
+    void writeTile(const mapbox::geometry::point<T>& p) {
+        out.u8(1);
+        writePoint(p);
+    }
+    void writeTile(const mapbox::geometry::line_string<T>& line) {
+        out.u8(2);
+        writePoints(line);
+    }
+    void writeTile(const mapbox::geometry::polygon<T>& polygon) {
+        out.u8(3);
+        writeRings(polygon);
+    }
+    void writeTile(const mapbox::geometry::multi_point<T>& points) {
+        out.u8(4);
+        writePoints(points);
+    }
+    void writeTile(const mapbox::geometry::multi_line_string<T>& lines) {
+        out.u8(5);
+        writeRings(lines);
+    }
+    void writeTile(const mapbox::geometry::multi_polygon<T>& polygons) {
+        out.u8(6);
+        out.varint(polygons.size());
+        for (const auto& polygon : polygons) {
+            writeRings(polygon);
+        }
+    }
+    void writeTile(const mapbox::geometry::geometry_collection<T>& collection) {
+        out.u8(7);
+        out.varint(collection.size());
+        for (const auto& geometry : collection) {
+            write(geometry);
+        }
+    }
+    template <class U>
+    void writeTile(const U&) {
+        throw std::runtime_error("Can't save empty geometry in a tile index");
+    }
+
+    void writePoint(const mapbox::geometry::point<T>& p) {
+        writeCoordinate(p.x, std::is_integral<T>{});
+        writeCoordinate(p.y, std::is_integral<T>{});
+    }
+    // integer coordinates are zigzag varints, floating-point ones are stored as they are
+    void writeCoordinate(const T value, std::true_type) {
+        out.svarint(value);
+    }
+    void writeCoordinate(const T value, std::false_type) {
+        out.f64(value);
+    }
+    template <class Points>
+    void writePoints(const Points& points) {
+        out.varint(points.size());
+        for (const auto& p : points) {
+            writePoint(p);
+        }
+    }
+    template <class Rings>
+    void writeRings(const Rings& rings) {
+        out.varint(rings.size());
+        for (const auto& ring : rings) {
+            writePoints(ring);
+        }
+    }
+
+    // source geometry
+    void write(const vt_geometry& geometry) {
+        vt_geometry::visit(geometry, [&](const auto& g) { this->writeSource(g); });
+    }
+    void writeSource(const vt_point& p) {
+        out.u8(1);
+        writePoint(p);
+    }
+    void writeSource(const vt_line_string& line) {
+        out.u8(2);
+        writeLine(line);
+    }
+    void writeSource(const vt_polygon& polygon) {
+        out.u8(3);
+        writePolygon(polygon);
+    }
+    void writeSource(const vt_multi_point& points) {
+        out.u8(4);
+        writePoints(points);
+    }
+    void writeSource(const vt_multi_line_string& lines) {
+        out.u8(5);
+        out.varint(lines.size());
+        for (const auto& line : lines) {
+            writeLine(line);
+        }
+    }
+    void writeSource(const vt_multi_polygon& polygons) {
+        out.u8(6);
+        out.varint(polygons.size());
+        for (const auto& polygon : polygons) {
+            writePolygon(polygon);
+        }
+    }
+    void writeSource(const vt_geometry_collection& collection) {
+        out.u8(7);
+        out.varint(collection.size());
+        for (const auto& geometry : collection) {
+            write(geometry);
+        }
+    }
+
+    void writePoint(const vt_point& p) {
+        out.f64(p.x);
+        out.f64(p.y);
+        out.f64(p.z);
+    }
+    void writePoints(const std::vector<vt_point>& points) {
+        out.varint(points.size());
+        for (const auto& p : points) {
+            writePoint(p);
+        }
+    }
+    void writeLine(const vt_line_string& line) {
+        writePoints(line);
+        out.f64(line.dist);
+    }
+    void writePolygon(const vt_polygon& polygon) {
+        out.varint(polygon.size());
+        for (const auto& ring : polygon) {
+            writePoints(ring);
+            out.f64(ring.area);
+        }
+    }
+};
+
+template <class T>
+class TileRecordReader {
+public:
+    // source features' properties are interned through `pool`, which `poolMutex` guards
+    TileRecordReader(ByteReader& in_, PropertyPool& pool_, std::mutex& poolMutex_)
+        : in(in_), pool(pool_), poolMutex(poolMutex_) {
+    }
+
+    void read(BasicInternalTile<T>& tile) {
+        tile.is_solid = in.u8() != 0;
+        tile.bbox.min.x = in.f64();
+        tile.bbox.min.y = in.f64();
+        tile.bbox.max.x = in.f64();
+        tile.bbox.max.y = in.f64();
+        tile.tile.num_points = static_cast<uint32_t>(in.varint());
+        tile.tile.num_simplified = static_cast<uint32_t>(in.varint());
+
+        const std::size_t features = in.count();
+        tile.tile.features.reserve(features);
+        for (std::size_t i = 0; i < features; ++i) {
+            auto geometry = readTile();
+            auto properties = readProperties();
+            tile.tile.features.push_back({ std::move(geometry), std::move(properties), readID() });
+        }
+
+        const std::size_t sources = in.count();
+        tile.source_features.reserve(sources);
+        for (std::size_t i = 0; i < sources; ++i) {
+            auto geometry = readSource();
+            auto properties = intern(readProperties());
+            tile.source_features.emplace_back(std::move(geometry), std::move(properties), readID());
+        }
+    }
+
+private:
+    ByteReader& in;
+    PropertyPool& pool;
+    std::mutex& poolMutex;
+
+    std::shared_ptr<const property_map> intern(const property_map& properties) {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        return pool.intern(properties);
+    }
+
+    property_map readProperties() {
+        property_map properties;
+        const std::size_t size = in.count();
+        for (std::size_t i = 0; i < size; ++i) {
+            auto key = in.string();
+            switch (in.u8()) {
+            case 0:
+                properties.emplace(std::move(key), mapbox::geometry::null_value);
+                break;
+            case 1:
+                properties.emplace(std::move(key), in.u8() != 0);
+                break;
+            case 2:
+                properties.emplace(std::move(key), in.varint());
+                break;
+            case 3:
+                properties.emplace(std::move(key), in.svarint());
+                break;
+            case 4:
+                properties.emplace(std::move(key), in.f64());
+                break;
+            case 5:
+                properties.emplace(std::move(key), in.string());
+                break;
+            default:
+                throw std::runtime_error("Invalid tile index: unknown property type");
+            }
+        }
+        return properties;
+    }
+
+    optional<identifier> readID() {
+        switch (in.u8()) {
+        case 0:
+            return {};
+        case 2:
+            return identifier{ in.varint() };
+        case 3:
+            return identifier{ in.svarint() };
+        case 4:
+            return identifier{ in.f64() };
+        case 5:
+            return identifier{ in.string() };
+        default:
+            throw std::runtime_error("Invalid tile index: unknown id type");
+        }
+    }
+
+    mapbox::geometry::point<T> readTilePoint() {
+        const auto x = static_cast<T>(in.svarint());
+        const auto y = static_cast<T>(in.svarint());
+        return { x, y };
+    }
+    template <class Points>
+    Points readTilePoints() {
+        Points points;
+        const std::size_t size = in.count();
+        points.reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            points.push_back(readTilePoint());
+        }
+        return points;
+    }
+    template <class Rings>
+    Rings readTileRings() {
+        Rings rings;
+        const std::size_t size = in.count();
+        rings.reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            rings.push_back(this->template readTilePoints<typename Rings::value_type>());
+        }
+        return rings;
+    }
+
+    mapbox::geometry::geometry<T> readTile() {
+        switch (in.u8()) {
+        case 1:
+            return readTilePoint();
+        case 2:
+            return readTilePoints<mapbox::geometry::line_string<T>>();
+        case 3:
+            return readTileRings<mapbox::geometry::polygon<T>>();
+        case 4:
+            return readTilePoints<mapbox::geometry::multi_point<T>>();
+        case 5:
+            return readTileRings<mapbox::geometry::multi_line_string<T>>();
+        case 6: {
+            mapbox::geometry::multi_polygon<T> polygons;
+            const std::size_t size = in.count();
+            polygons.reserve(size);
+            for (std::size_t i = 0; i < size; ++i) {
+                polygons.push_back(readTileRings<mapbox::geometry::polygon<T>>());
+            }
+            return polygons;
+        }
+        case 7: {
+            mapbox::geometry::geometry_collection<T> collection;
+            const std::size_t size = in.count();
+            collection.reserve(size);
+            for (std::size_t i = 0; i < size; ++i) {
+                collection.push_back(readTile());
+            }
+            return collection;
+        }
+        default:
+            throw std::runtime_error("Invalid tile index: unknown geometry type");
+        }
+    }
+
+    vt_point readPoint() {
+        const double x = in.f64();
+        const double y = in.f64();
+        const double z = in.f64();
+        return { x, y, z };
+    }
+    template <class Points>
+    Points readPoints() {
+        Points points;
+        const std::size_t size = in.count();
+        points.reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            points.push_back(readPoint());
+        }
+        return points;
+    }
+    vt_line_string readLine() {
+        auto line = readPoints<vt_line_string>();
+        line.dist = in.f64();
+        return line;
+    }
+    vt_polygon readPolygon() {
+        vt_polygon polygon;
+        const std::size_t size = in.count();
+        polygon.reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            polygon.push_back(readPoints<vt_linear_ring>());
+            polygon.back().area = in.f64();
+        }
+        return polygon;
+    }
+
+    vt_geometry readSource() {
+        switch (in.u8()) {
+        case 1:
+            return readPoint();
+        case 2:
+            return readLine();
+        case 3:
+            return readPolygon();
+        case 4:
+            return readPoints<vt_multi_point>();
+        case 5: {
+            vt_multi_line_string lines;
+            const std::size_t size = in.count();
+            lines.reserve(size);
+            for (std::size_t i = 0; i < size; ++i) {
+                lines.push_back(readLine());
+            }
+            return lines;
+        }
+        case 6: {
+            vt_multi_polygon polygons;
+            const std::size_t size = in.count();
+            polygons.reserve(size);
+            for (std::size_t i = 0; i < size; ++i) {
+                polygons.push_back(readPolygon());
+            }
+            return polygons;
+        }
+        case 7: {
+            vt_geometry_collection collection;
+            const std::size_t size = in.count();
+            collection.reserve(size);
+            for (std::size_t i = 0; i < size; ++i) {
+                collection.push_back(readSource());
+            }
+            return collection;
+        }
+        default:
+            throw std::runtime_error("Invalid tile index: unknown geometry type");
+        }
+    }
+};
+
+// read-only view of a whole file, memory-mapped where the platform allows it
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef GEOJSONVT_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Failed to open tile index " + path);
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            length = static_cast<std::size_t>(info.st_size);
+            void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+                mapping = static_cast<const char*>(mapped);
+        }
+        ::close(fd);
+        if (!mapping)
+            throw std::runtime_error("Failed to map tile index " + path);
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Failed to open tile index " + path);
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        mapping = buffer.data();
+        length = buffer.size();
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef GEOJSONVT_MMAP
+        ::munmap(const_cast<char*>(mapping), length);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const {
+        return mapping;
+    }
+    std::size_t size() const {
+        return length;
+    }
+
+private:
+    const char* mapping = nullptr;
+    std::size_t length = 0;
+#ifndef GEOJSONVT_MMAP
+    std::vector<char> buffer;
+#endif
+};
+
+// a saved tile index; lookups and decoding only read the file, and decoded properties are
+// interned under a lock, so they are thread-safe
+class IndexFile {
+public:
+    explicit IndexFile(const std::string& path) : file(path) {
+        static constexpr std::size_t trailer_size = 20;
+        if (file.size() < 8 + trailer_size || std::memcmp(file.data(), index_magic, 4) != 0 ||
+            std::memcmp(file.data() + file.size() - 4, index_magic, 4) != 0)
+            throw std::runtime_error("Invalid tile index: " + path + " is not a tile index");
+
+        ByteReader in(file.data() + 4, file.size() - 4);
+        if (in.u32() != index_version)
+            throw std::runtime_error("Invalid tile index: unsupported version");
+        header.maxZoom = in.u8();
+        header.indexMaxZoom = in.u8();
+        header.indexMaxPoints = in.u32();
+        header.solidChildren = in.u8() != 0;
+        header.tolerance = in.f64();
+        header.maxPointsPerTile = in.u32();
+        header.extent = in.u16();
+        header.buffer = in.u16();
+        header.coordinates = in.u8();
+        header.fixedPoint = in.u8() != 0;
+        header.total = in.u32();
+        const std::size_t zooms = in.count();
+        for (std::size_t i = 0; i < zooms; ++i) {
+            const uint8_t z = in.u8();
+            header.stats.emplace_back(z, in.u32());
+        }
+
+        ByteReader trailer(file.data() + file.size() - trailer_size, trailer_size);
+        const uint64_t offset = trailer.u64();
+        count = trailer.u64();
+        if (offset > file.size() - trailer_size ||
+            count > (file.size() - trailer_size - offset) / entry_size)
+            throw std::runtime_error("Invalid tile index: corrupt directory");
+        directory = file.data() + offset;
+    }
+
+    const IndexHeader& getHeader() const {
+        return header;
+    }
+
+    std::size_t size() const {
+        return count;
+    }
+
+    uint64_t idAt(const std::size_t i) const {
+        return field(i, 0);
+    }
+
+    bool contains(const uint64_t id) const {
+        return find(id) < count;
+    }
+
+    // the raw record of the i-th tile in id order
+    std::pair<const char*, std::size_t> record(const std::size_t i) const {
+        const uint64_t offset = field(i, 1);
+        const uint64_t size = field(i, 2);
+        if (offset > file.size() || size > file.size() - offset)
+            throw std::runtime_error("Invalid tile index: corrupt directory");
+        return { file.data() + offset, static_cast<std::size_t>(size) };
+    }
+
+    template <class T>
+    BasicInternalTile<T>
+    decode(const uint64_t id,
+           const double tolerance,
+           const double sourceTolerance = 0,
+           const double grid = 0) const {
+        if (header.coordinates != coordinateType<T>())
+            throw std::runtime_error("Invalid tile index: saved with another coordinate type");
+        const std::size_t i = find(id);
+        if (i == count)
+            throw std::out_of_range("Tile not found");
+
+        const auto data = record(i);
+        const uint8_t z = id % 32;
+        BasicInternalTile<T> tile(z, (id / 32) % (1ull << z), (id / 32) >> z, header.extent,
+                                  tolerance, header.maxPointsPerTile, sourceTolerance, grid);
+        ByteReader in(data.first, data.second);
+        TileRecordReader<T>(in, properties, propertiesMutex).read(tile);
+        return tile;
+    }
+
+    static constexpr std::size_t entry_size = 24;
+
+private:
+    MappedFile file;
+    IndexHeader header;
+    const char* directory = nullptr;
+    std::size_t count = 0;
+
+    // the property maps of decoded source features, shared by the tiles a feature is in as
+    // they are when the index is built
+    mutable PropertyPool properties;
+    mutable std::mutex propertiesMutex;
+
+    uint64_t field(const std::size_t i, const std::size_t index) const {
+        ByteReader in(directory + i * entry_size + index * 8, 8);
+        return in.u64();
+    }
+
+    // index of the tile in the directory, or `count` if it's not there
+    std::size_t find(const uint64_t id) const {
+        std::size_t lo = 0;
+        std::size_t hi = count;
+        while (lo < hi) {
+            const std::size_t mid = lo + (hi - lo) / 2;
+            if (idAt(mid) < id)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo < count && idAt(lo) == id ? lo : count;
+    }
+};
+
+/* writes a tile index file; `writeTile` and `writeRecord` append tiles in any order, and
+ * `finish` moves the file into place, so an index that's mapped from `path` stays intact
+ */
+class IndexFileWriter {
+public:
+    IndexFileWriter(const std::string& path_, const IndexHeader& header)
+        : path(path_), file(path + ".tmp", std::ios::binary | std::ios::trunc) {
+        if (!file)
+            throw std::runtime_error("Failed to create tile index " + path);
+
+        ByteWriter out;
+        out.data.append(index_magic, 4);
+        out.u32(index_version);
+        out.u8(header.maxZoom);
+        out.u8(header.indexMaxZoom);
+        out.u32(header.indexMaxPoints);
+        out.u8(header.solidChildren ? 1 : 0);
+        out.f64(header.tolerance);
+        out.u32(header.maxPointsPerTile);
+        out.u16(header.extent);
+        out.u16(header.buffer);
+        out.u8(header.coordinates);
+        out.u8(header.fixedPoint ? 1 : 0);
+        out.u32(header.total);
+        out.varint(header.stats.size());
+        for (const auto& stat : header.stats) {
+            out.u8(stat.first);
+            out.u32(stat.second);
+        }
+        append(out.data);
+    }
+
+    // an index that wasn't finished, e.g. since writing a tile threw, leaves nothing behind
+    ~IndexFileWriter() {
+        if (!finished) {
+            file.close();
+            std::remove((path + ".tmp").c_str());
+        }
+    }
+
+    IndexFileWriter(const IndexFileWriter&) = delete;
+    IndexFileWriter& operator=(const IndexFileWriter&) = delete;
+
+    template <class T>
+    void writeTile(const uint64_t id, const BasicInternalTile<T>& tile) {
+        writeTile(id, tile, tile.source_features);
+    }
+
+    template <class T>
+    void writeTile(const uint64_t id,
+                   const BasicInternalTile<T>& tile,
+                   const vt_features& sources) {
+        record.data.clear();
+        TileRecordWriter<T>(record).write(tile, sources);
+        writeRecord(id, record.data.data(), record.data.size());
+    }
+
+    void writeRecord(const uint64_t id, const char* data, const std::size_t size) {
+        entries.push_back({ id, offset, size });
+        append(data, size);
+    }
+
+    void finish() {
+        std::sort(entries.begin(), entries.end(),
+                  [](const Entry& a, const Entry& b) { return a.id < b.id; });
+
+        ByteWriter out;
+        const uint64_t directory = offset;
+        for (const auto& entry : entries) {
+            out.u64(entry.id);
+            out.u64(entry.offset);
+            out.u64(entry.size);
+        }
+        out.u64(directory);
+        out.u64(entries.size());
+        out.data.append(index_magic, 4);
+        append(out.data);
+
+        file.close();
+        const std::string temporary = path + ".tmp";
+        if (!file)
+            throw std::runtime_error("Failed to write tile index " + path);
+        // renaming over an existing file fails on some platforms
+        if (std::rename(temporary.c_str(), path.c_str()) != 0 &&
+            (std::remove(path.c_str()) != 0 || std::rename(temporary.c_str(), path.c_str()) != 0))
+            throw std::runtime_error("Failed to write tile index " + path);
+        finished = true;
+    }
+
+private:
+    struct Entry {
+        uint64_t id;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    const std::string path;
+    std::ofstream file;
+    uint64_t offset = 0;
+    std::vector<Entry> entries;
+    ByteWriter record;
+    bool finished = false;
+
+    void append(const std::string& data) {
+        append(data.data(), data.size());
+    }
+    void append(const char* data, const std::size_t size) {
+        file.write(data, static_cast<std::streamsize>(size));
+        offset += size;
+    }
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
@@ -0,0 +1,428 @@
+#pragma once
+
+#include <mapbox/geojsonvt/tile.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+
+namespace detail {
+namespace pbf {
+
+enum wire_type : uint32_t { varint = 0, fixed64 = 1, length_delimited = 2 };
+
+inline void writeVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+inline std::size_t varintSize(uint64_t value) {
+    std::size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+inline uint32_t zigzag(const int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+inline uint64_t zigzag(const int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline void writeKey(std::string& out, const uint32_t field, const wire_type type) {
+    writeVarint(out, (field << 3) | type);
+}
+
+inline void writeBytes(std::string& out, const uint32_t field, const std::string& data) {
+    writeKey(out, field, length_delimited);
+    writeVarint(out, data.size());
+    out += data;
+}
+
+inline void writePacked(std::string& out, const uint32_t field, const std::vector<uint32_t>& data) {
+    std::size_t size = 0;
+    for (const uint32_t value : data) {
+        size += varintSize(value);
+    }
+    writeKey(out, field, length_delimited);
+    writeVarint(out, size);
+    for (const uint32_t value : data) {
+        writeVarint(out, value);
+    }
+}
+
+inline void writeDouble(std::string& out, const uint32_t field, const double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeKey(out, field, fixed64);
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>((bits >> (i * 8)) & 0xff));
+    }
+}
+
+} // namespace pbf
+
+/* encodes features into a single layer of a Mapbox Vector Tile (version 2):
+ * geometry is written as zigzag/delta command streams, dropping repeated points and
+ * degenerate lines and rings, with exterior rings wound clockwise and holes counter-clockwise
+ * in tile coordinates as the spec requires; keys and values are deduplicated per layer
+ */
+
+template <class T>
+class MVTLayer {
+    // MVT coordinates are signed 32-bit integers
+    static_assert(std::is_integral<T>::value && sizeof(T) <= sizeof(int32_t),
+                  "vector tiles need integer coordinates of at most 32 bits");
+
+public:
+    using point_type = mapbox::geometry::point<T>;
+
+    MVTLayer(const std::string& name_, const uint32_t extent_) : name(name_), extent(extent_) {
+    }
+
+    void addFeature(const mapbox::geometry::feature<T>& feature) {
+        addGeometry(feature.geometry, feature.properties, feature.id);
+    }
+
+    bool empty() const {
+        return features.empty();
+    }
+
+    // appends the layer as a field of the Tile message
+    void write(std::string& out) const {
+        std::string header;
+        pbf::writeKey(header, 15, pbf::varint); // version
+        pbf::writeVarint(header, 2);
+        pbf::writeBytes(header, 1, name);
+
+        std::string footer;
+        for (const auto& key : keys) {
+            pbf::writeBytes(footer, 3, key);
+        }
+        for (const auto& value : values) {
+            pbf::writeBytes(footer, 4, value);
+        }
+        pbf::writeKey(footer, 5, pbf::varint);
+        pbf::writeVarint(footer, extent);
+
+        pbf::writeKey(out, 3, pbf::length_delimited);
+        pbf::writeVarint(out, header.size() + features.size() + footer.size());
+        out += header;
+        out += features;
+        out += footer;
+    }
+
+private:
+    enum geom_type : uint32_t { type_unknown = 0, type_point = 1, type_line = 2, type_polygon = 3 };
+    enum command : uint32_t { move_to = 1, line_to = 2, close_path = 7 };
+
+    const std::string name;
+    const uint32_t extent;
+
+    std::string features;
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    std::unordered_map<std::string, uint32_t> key_index;
+    std::unordered_map<std::string, uint32_t> value_index;
+
+    // scratch buffers reused between features
+    std::vector<uint32_t> geometry;
+    std::vector<uint32_t> tags;
+    std::vector<point_type> part;
+    std::string message;
+    std::string value;
+    int32_t cursor_x = 0;
+    int32_t cursor_y = 0;
+
+    void addGeometry(const mapbox::geometry::geometry<T>& geom,
+                     const property_map& props,
+                     const optional<identifier>& id) {
+        mapbox::geometry::geometry<T>::visit(geom, [&](const auto& g) {
+            // `this->` is a workaround for https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61636
+            this->addGeometry(g, props, id);
+        });
+    }
+
+    // members of a collection become features of their own, since a feature has a single type
+    void addGeometry(const mapbox::geometry::geometry_collection<T>& collection,
+                     const property_map& props,
+                     const optional<identifier>& id) {
+        for (const auto& geom : collection) {
+            addGeometry(geom, props, id);
+        }
+    }
+
+    template <class U>
+    void addGeometry(const U& geom, const property_map& props, const optional<identifier>& id) {
+        geometry.clear();
+        cursor_x = 0;
+        cursor_y = 0;
+        const geom_type type = encode(geom);
+        if (geometry.empty())
+            return;
+
+        message.clear();
+        uint64_t numeric_id;
+        if (id && identifier::visit(*id, FeatureID{ numeric_id })) {
+            pbf::writeKey(message, 1, pbf::varint);
+            pbf::writeVarint(message, numeric_id);
+        }
+        encodeTags(props);
+        if (!tags.empty())
+            pbf::writePacked(message, 2, tags);
+        pbf::writeKey(message, 3, pbf::varint);
+        pbf::writeVarint(message, type);
+        pbf::writePacked(message, 4, geometry);
+
+        pbf::writeBytes(features, 2, message);
+    }
+
+    geom_type encode(const mapbox::geometry::point<T>& p) {
+        geometry.push_back(commandInteger(move_to, 1));
+        addPoint(p);
+        return type_point;
+    }
+
+    geom_type encode(const mapbox::geometry::multi_point<T>& points) {
+        if (!points.empty()) {
+            geometry.push_back(commandInteger(move_to, static_cast<uint32_t>(points.size())));
+            for (const auto& p : points) {
+                addPoint(p);
+            }
+        }
+        return type_point;
+    }
+
+    geom_type encode(const mapbox::geometry::line_string<T>& line) {
+        addLine(line);
+        return type_line;
+    }
+
+    geom_type encode(const mapbox::geometry::multi_line_string<T>& lines) {
+        for (const auto& line : lines) {
+            addLine(line);
+        }
+        return type_line;
+    }
+
+    geom_type encode(const mapbox::geometry::polygon<T>& rings) {
+        addPolygon(rings);
+        return type_polygon;
+    }
+
+    geom_type encode(const mapbox::geometry::multi_polygon<T>& polygons) {
+        for (const auto& rings : polygons) {
+            addPolygon(rings);
+        }
+        return type_polygon;
+    }
+
+    template <class U>
+    geom_type encode(const U&) {
+        return type_unknown;
+    }
+
+    static uint32_t commandInteger(const command id, const uint32_t count) {
+        return (id & 0x7) | (count << 3);
+    }
+
+    // the difference of two 32-bit coordinates can take 33 bits, so it's taken in 64 bits and
+    // rejected when it doesn't fit the 32-bit parameter
+    void addPoint(const point_type& p) {
+        const int64_t dx = static_cast<int64_t>(p.x) - cursor_x;
+        const int64_t dy = static_cast<int64_t>(p.y) - cursor_y;
+        if (dx < std::numeric_limits<int32_t>::min() || dx > std::numeric_limits<int32_t>::max() ||
+            dy < std::numeric_limits<int32_t>::min() || dy > std::numeric_limits<int32_t>::max())
+            throw std::runtime_error("Can't encode points more than 2^31 apart in a vector tile");
+        geometry.push_back(static_cast<uint32_t>(pbf::zigzag(dx)));
+        geometry.push_back(static_cast<uint32_t>(pbf::zigzag(dy)));
+        cursor_x = p.x;
+        cursor_y = p.y;
+    }
+
+    // copies the points into `part`, skipping repeated ones, which LineTo doesn't allow
+    template <class Points>
+    void collectPart(const Points& points) {
+        part.clear();
+        for (const auto& p : points) {
+            if (part.empty() || p != part.back())
+                part.push_back(p);
+        }
+    }
+
+    void addLine(const mapbox::geometry::line_string<T>& line) {
+        collectPart(line);
+        if (part.size() < 2)
+            return;
+
+        geometry.push_back(commandInteger(move_to, 1));
+        addPoint(part.front());
+        geometry.push_back(commandInteger(line_to, static_cast<uint32_t>(part.size() - 1)));
+        for (std::size_t i = 1; i < part.size(); ++i) {
+            addPoint(part[i]);
+        }
+    }
+
+    void addPolygon(const mapbox::geometry::polygon<T>& rings) {
+        for (std::size_t i = 0; i < rings.size(); ++i) {
+            // holes are dropped along with a degenerate exterior ring
+            if (!addRing(rings[i], i == 0) && i == 0)
+                return;
+        }
+    }
+
+    bool addRing(const mapbox::geometry::linear_ring<T>& ring, const bool exterior) {
+        collectPart(ring);
+        // the closing point is implied by ClosePath
+        while (part.size() > 1 && part.back() == part.front()) {
+            part.pop_back();
+        }
+        if (part.size() < 3)
+            return false;
+
+        // twice the signed area, positive for clockwise rings in tile coordinates (y down)
+        int64_t area = 0;
+        for (std::size_t i = 0, j = part.size() - 1; i < part.size(); j = i++) {
+            area += static_cast<int64_t>(part[j].x) * part[i].y -
+                    static_cast<int64_t>(part[i].x) * part[j].y;
+        }
+        if (area == 0)
+            return false;
+
+        const bool reverse = exterior ? area < 0 : area > 0;
+        const std::size_t n = part.size();
+        const auto at = [&](const std::size_t k) -> const point_type& {
+            return reverse ? part[n - 1 - k] : part[k];
+        };
+
+        geometry.push_back(commandInteger(move_to, 1));
+        addPoint(at(0));
+        geometry.push_back(commandInteger(line_to, static_cast<uint32_t>(n - 1)));
+        for (std::size_t k = 1; k < n; ++k) {
+            addPoint(at(k));
+        }
+        geometry.push_back(commandInteger(close_path, 1));
+        return true;
+    }
+
+    void encodeTags(const property_map& props) {
+        tags.clear();
+        for (const auto& property : props) {
+            value.clear();
+            if (!mapbox::geometry::value::visit(property.second, Value{ value }))
+                continue;
+
+            const auto key = key_index.emplace(property.first, keys.size());
+            if (key.second)
+                keys.push_back(property.first);
+            const auto val = value_index.emplace(value, values.size());
+            if (val.second)
+                values.push_back(value);
+
+            tags.push_back(key.first->second);
+            tags.push_back(val.first->second);
+        }
+    }
+
+    // writes a property value as the body of a Value message; false for values MVT can't hold
+    struct Value {
+        std::string& out;
+
+        bool operator()(const std::string& v) const {
+            pbf::writeBytes(out, 1, v);
+            return true;
+        }
+        bool operator()(const double v) const {
+            pbf::writeDouble(out, 3, v);
+            return true;
+        }
+        bool operator()(const int64_t v) const {
+            if (v >= 0)
+                return (*this)(static_cast<uint64_t>(v));
+            pbf::writeKey(out, 6, pbf::varint);
+            pbf::writeVarint(out, pbf::zigzag(v));
+            return true;
+        }
+        bool operator()(const uint64_t v) const {
+            pbf::writeKey(out, 5, pbf::varint);
+            pbf::writeVarint(out, v);
+            return true;
+        }
+        bool operator()(const bool v) const {
+            pbf::writeKey(out, 7, pbf::varint);
+            pbf::writeVarint(out, v ? 1 : 0);
+            return true;
+        }
+        // null, nested lists and maps
+        template <class U>
+        bool operator()(const U&) const {
+            return false;
+        }
+    };
+
+    // MVT feature ids are unsigned integers, other ids are left out
+    struct FeatureID {
+        uint64_t& out;
+
+        bool operator()(const uint64_t v) const {
+            out = v;
+            return true;
+        }
+        bool operator()(const int64_t v) const {
+            out = static_cast<uint64_t>(v);
+            return v >= 0;
+        }
+        bool operator()(const double v) const {
+            if (!(v >= 0 && v < 18446744073709551616.0))
+                return false;
+            out = static_cast<uint64_t>(v);
+            return static_cast<double>(out) == v;
+        }
+        bool operator()(const std::string&) const {
+            return false;
+        }
+    };
+};
+
+} // namespace detail
+
+// appends the tile as a vector tile layer to `out`, so several layers encoded into the same
+// buffer form one multi-layer tile; a tile without any features adds nothing
+template <class T>
+void encodeMVT(const BasicTile<T>& tile,
+               const std::string& layerName,
+               std::string& out,
+               const uint32_t extent = 4096) {
+    detail::MVTLayer<T> layer(layerName, extent);
+    for (const auto& feature : tile.features) {
+        layer.addFeature(feature);
+    }
+    if (!layer.empty())
+        layer.write(out);
+}
+
+template <class T>
+std::string
+encodeMVT(const BasicTile<T>& tile, const std::string& layerName, const uint32_t extent = 4096) {
+    std::string out;
+    encodeMVT(tile, layerName, out, extent);
+    return out;
+}
+
+} // namespace geojsonvt
+} // namespace mapbox
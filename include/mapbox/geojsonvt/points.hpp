@@ -0,0 +1,297 @@
+#pragma once
+
+#include <mapbox/geojsonvt/convert.hpp>
+#include <mapbox/geojsonvt/properties.hpp>
+#include <mapbox/geojsonvt/tile.hpp>
+#include <mapbox/geojsonvt/types.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+
+struct PointOptions {
+    // max zoom tiles are generated for; points are stored on a 32-bit grid, so 2^maxZoom times
+    // the extent must stay within 2^30 to keep them at a fraction of a tile unit
+    uint8_t maxZoom = 18;
+
+    // tile extent; extent plus buffer must fit the tile coordinate type
+    uint16_t extent = 4096;
+
+    // tile buffer on each side
+    uint16_t buffer = 64;
+
+    // max number of points per tile (0 means no limit); tiles with more keep a subset evenly
+    // spread along the curve the points are sorted by
+    uint32_t maxPointsPerTile = 0;
+};
+
+namespace detail {
+
+// spreads the bits of x over the even bits of the result
+inline uint64_t spreadBits(const uint32_t x) {
+    uint64_t v = x;
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+    v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+    v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    v = (v | (v << 2)) & 0x3333333333333333ull;
+    v = (v | (v << 1)) & 0x5555555555555555ull;
+    return v;
+}
+
+// the even bits of v, packed back together
+inline uint32_t compactBits(uint64_t v) {
+    v &= 0x5555555555555555ull;
+    v = (v | (v >> 1)) & 0x3333333333333333ull;
+    v = (v | (v >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+    v = (v | (v >> 4)) & 0x00FF00FF00FF00FFull;
+    v = (v | (v >> 8)) & 0x0000FFFF0000FFFFull;
+    v = (v | (v >> 16)) & 0x00000000FFFFFFFFull;
+    return static_cast<uint32_t>(v);
+}
+
+// position on the Z-order curve, x in the even bits and y in the odd ones; every tile is then
+// one contiguous range of positions
+inline uint64_t morton(const uint32_t x, const uint32_t y) {
+    return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+// a projected coordinate in [0, 1) on the 32-bit grid, and the center of its grid cell back
+inline uint32_t quantize(const double k) {
+    return static_cast<uint32_t>(std::min(std::max(k, 0.0) * 4294967296.0, 4294967295.0));
+}
+
+inline double dequantize(const uint32_t q) {
+    return (q + 0.5) / 4294967296.0;
+}
+
+} // namespace detail
+
+/* tiles a point cloud, e.g. millions of POIs, without going through the tile pyramid: the
+ * points are projected once, sorted along the Z-order curve and kept as a position and a feature
+ * number each, so the points of any tile (buffer included) are a few binary-searched ranges of
+ * that order, and tiles come out with the same points GeoJSONVT gives them, ordered along the
+ * curve, without clipping or storing any tiles
+ *
+ * point and multi-point features are taken, each point of a multi-point becoming a point
+ * feature of its own with the multi-point's properties and id; features with the same
+ * properties share them
+ */
+
+template <class T>
+class BasicPointIndex {
+public:
+    const PointOptions options;
+
+    BasicPointIndex(const mapbox::geometry::feature_collection<double>& features,
+                    const PointOptions& options_ = PointOptions())
+        : options(options_) {
+        detail::checkExtent<T>(options.extent, options.buffer);
+        if (std::ldexp(double(options.extent), options.maxZoom) > 1073741824.0)
+            throw std::runtime_error("Point index maxZoom too high for the extent: " +
+                                     std::to_string(options.maxZoom));
+
+        detail::PropertyPool pool;
+        std::vector<std::pair<uint64_t, uint32_t>> points;
+        bool hasIDs = false;
+        for (const auto& feature : features) {
+            const uint32_t number = static_cast<uint32_t>(properties.size());
+            const auto add = [&](const mapbox::geometry::point<double>& p) {
+                const auto projected = detail::project{ 0 }(p);
+                points.emplace_back(detail::morton(detail::quantize(projected.x -
+                                                                    std::floor(projected.x)),
+                                                   detail::quantize(projected.y)),
+                                    number);
+            };
+            if (feature.geometry.is<mapbox::geometry::point<double>>()) {
+                add(feature.geometry.get<mapbox::geometry::point<double>>());
+            } else if (feature.geometry.is<mapbox::geometry::multi_point<double>>()) {
+                for (const auto& p : feature.geometry.get<mapbox::geometry::multi_point<double>>())
+                    add(p);
+            } else {
+                throw std::runtime_error("Point index features must be points or multi-points");
+            }
+            properties.push_back(pool.intern(feature.properties));
+            ids.push_back(feature.id);
+            hasIDs = hasIDs || feature.id;
+        }
+        if (!hasIDs)
+            ids = {};
+
+        // features are numbered in input order, which breaks ties between equal positions
+        std::sort(points.begin(), points.end());
+        positions.reserve(points.size());
+        owners.reserve(points.size());
+        for (const auto& point : points) {
+            positions.push_back(point.first);
+            owners.push_back(point.second);
+        }
+    }
+
+    // the tile, built from the points on every call; safe to call from several threads at once
+    BasicTile<T> getTile(const uint8_t z, const uint32_t x_, const uint32_t y) const {
+        if (z > options.maxZoom)
+            throw std::runtime_error("Requested zoom higher than maxZoom: " + std::to_string(z));
+
+        const uint32_t z2 = 1u << z;
+        const uint32_t x = ((x_ % z2) + z2) % z2; // wrap tile x coordinate
+        const double b = double(options.buffer) / options.extent;
+        const double minX = (x - b) / z2;
+        const double maxX = (x + 1 + b) / z2;
+        const double minY = (y - b) / z2;
+        const double maxY = (y + 1 + b) / z2;
+
+        // the buffer of tiles at the antimeridian reaches into the other side of the world
+        std::vector<Part> parts;
+        std::vector<uint32_t> found;
+        collect(minX, maxX, minY, maxY, 0, parts, found);
+        if (minX < 0)
+            collect(minX + 1, 1, minY, maxY, -1, parts, found);
+        if (maxX > 1)
+            collect(0, maxX - 1, minY, maxY, 1, parts, found);
+
+        BasicTile<T> tile;
+        tile.num_points = static_cast<uint32_t>(found.size());
+        const std::size_t count = found.size();
+        const std::size_t kept =
+            options.maxPointsPerTile ? std::min<std::size_t>(count, options.maxPointsPerTile)
+                                     : count;
+        tile.features.reserve(kept);
+
+        auto part = parts.begin();
+        for (std::size_t k = 0; k < kept; ++k) {
+            const std::size_t i = kept == count ? k : k * count / kept;
+            while (i >= part->end)
+                ++part;
+            const uint64_t position = positions[found[i]];
+            const double px = detail::dequantize(detail::compactBits(position)) + part->shift;
+            const double py = detail::dequantize(detail::compactBits(position >> 1));
+            const uint32_t owner = owners[found[i]];
+            tile.features.push_back(
+                { mapbox::geometry::point<T>{
+                      toCoordinate((px * z2 - x) * options.extent, std::is_integral<T>{}),
+                      toCoordinate((py * z2 - y) * options.extent, std::is_integral<T>{}) },
+                  *properties[owner],
+                  ids.empty() ? detail::optional<detail::identifier>{} : ids[owner] });
+        }
+        tile.num_simplified = static_cast<uint32_t>(kept);
+        return tile;
+    }
+
+    // number of points, multi-points counting one per point
+    std::size_t size() const {
+        return positions.size();
+    }
+
+private:
+    // the curve positions of the points, sorted, and the number of the feature of each
+    std::vector<uint64_t> positions;
+    std::vector<uint32_t> owners;
+    std::vector<std::shared_ptr<const detail::property_map>> properties;
+    // left empty if no feature has an id
+    std::vector<detail::optional<detail::identifier>> ids;
+
+    // where the points found for one bounding box end, and how far they're shifted in x
+    struct Part {
+        std::size_t end;
+        double shift;
+    };
+
+    // a cell of the quadtree the curve follows, at `level` from 0 (the world) to 32, and the
+    // range of points that may be in it
+    struct Cell {
+        uint8_t level;
+        uint64_t prefix;
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    // appends the points inside the box, edges included, by descending the quadtree from the
+    // world: cells inside the box are taken whole, small or last-level ones point by point
+    void collect(const double minX,
+                 const double maxX,
+                 const double minY,
+                 const double maxY,
+                 const double shift,
+                 std::vector<Part>& parts,
+                 std::vector<uint32_t>& found) const {
+        // the grid cells whose centers are in the box
+        const double x1 = std::ceil(minX * 4294967296.0 - 0.5);
+        const double x2 = std::floor(maxX * 4294967296.0 - 0.5);
+        const double y1 = std::ceil(minY * 4294967296.0 - 0.5);
+        const double y2 = std::floor(maxY * 4294967296.0 - 0.5);
+        if (x1 <= x2 && y1 <= y2 && x2 >= 0 && y2 >= 0 && x1 < 4294967296.0 &&
+            y1 < 4294967296.0) {
+            const uint64_t qx1 = static_cast<uint64_t>(std::max(x1, 0.0));
+            const uint64_t qx2 = static_cast<uint64_t>(std::min(x2, 4294967295.0));
+            const uint64_t qy1 = static_cast<uint64_t>(std::max(y1, 0.0));
+            const uint64_t qy2 = static_cast<uint64_t>(std::min(y2, 4294967295.0));
+
+            std::vector<Cell> stack{ { 0, 0, 0, positions.size() } };
+            while (!stack.empty()) {
+                const Cell cell = stack.back();
+                stack.pop_back();
+
+                const uint8_t bits = 32 - cell.level;
+                const uint64_t cx1 = uint64_t(detail::compactBits(cell.prefix)) << bits;
+                const uint64_t cy1 = uint64_t(detail::compactBits(cell.prefix >> 1)) << bits;
+                const uint64_t cx2 = cx1 + (1ull << bits) - 1;
+                const uint64_t cy2 = cy1 + (1ull << bits) - 1;
+                if (cx1 > qx2 || cx2 < qx1 || cy1 > qy2 || cy2 < qy1)
+                    continue;
+
+                if (cx1 >= qx1 && cx2 <= qx2 && cy1 >= qy1 && cy2 <= qy2) {
+                    for (std::size_t i = cell.begin; i < cell.end; ++i)
+                        found.push_back(static_cast<uint32_t>(i));
+
+                } else if (cell.level == 32 || cell.end - cell.begin <= 16) {
+                    for (std::size_t i = cell.begin; i < cell.end; ++i) {
+                        const uint64_t px = detail::compactBits(positions[i]);
+                        const uint64_t py = detail::compactBits(positions[i] >> 1);
+                        if (px >= qx1 && px <= qx2 && py >= qy1 && py <= qy2)
+                            found.push_back(static_cast<uint32_t>(i));
+                    }
+
+                } else {
+                    // children are pushed last one first, so they're taken in curve order
+                    const uint8_t level = cell.level + 1;
+                    const unsigned shiftBits = 2 * (32 - level);
+                    std::size_t end = cell.end;
+                    for (int child = 3; child >= 0; --child) {
+                        const uint64_t prefix = (cell.prefix << 2) | uint64_t(child);
+                        const uint64_t first = prefix << shiftBits;
+                        const std::size_t begin =
+                            std::lower_bound(positions.begin() + cell.begin,
+                                             positions.begin() + end, first) -
+                            positions.begin();
+                        if (begin < end)
+                            stack.push_back({ level, prefix, begin, end });
+                        end = begin;
+                    }
+                }
+            }
+        }
+        parts.push_back({ found.size(), shift });
+    }
+
+    static T toCoordinate(const double value, std::true_type) {
+        return static_cast<T>(std::round(value));
+    }
+    static T toCoordinate(const double value, std::false_type) {
+        return static_cast<T>(value);
+    }
+};
+
+// point tiles with the default 16-bit coordinates
+using PointIndex = BasicPointIndex<int16_t>;
+
+} // namespace geojsonvt
+} // namespace mapbox
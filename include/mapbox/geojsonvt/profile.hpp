@@ -0,0 +1,179 @@
+#pragma once
+
+#include <mapbox/geojsonvt/types.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef GEOJSONVT_PROFILE
+#include <atomic>
+#include <chrono>
+#endif
+
+namespace mapbox {
+namespace geojsonvt {
+
+/* cumulative counters of the tiling stages, kept for the whole process when built with
+ * GEOJSONVT_PROFILE defined, and left out entirely otherwise (getProfile then returns zeros);
+ * times are in nanoseconds and stages nest, e.g. a drill-down's time includes its clipping
+ */
+
+// each stage's `_ns` counter follows its `_calls` one
+enum class Counter : std::size_t {
+    convert_calls,
+    convert_ns,
+    wrap_calls,
+    wrap_ns,
+    clip_x_calls, // clip<0>, including the world copies made by wrap
+    clip_x_ns,
+    clip_y_calls, // clip<1>
+    clip_y_ns,
+    split_calls, // tiles split into their four children in one pass
+    split_ns,
+    tile_calls, // tiles built from their clipped features
+    tile_ns,
+    transform_calls, // lazy tiles transformed on first use
+    transform_ns,
+
+    clip_trivial_accepts, // whole feature sets inside or outside the clip bounds
+    clip_trivial_rejects,
+    clip_feature_accepts, // single features inside or outside the clip bounds
+    clip_feature_rejects,
+    clip_features_clipped, // features that had to be cut
+    clip_points_in,        // points of the features that had to be cut, before and after
+    clip_points_out,
+
+    drill_downs, // getTile calls that clipped tiles below the index
+    drill_ns,
+    drilled_tiles,
+    cache_hits, // getTile calls answered by a tile that already existed
+    cache_misses,
+    evicted_tiles,
+    page_in_calls, // spilled source features read back in
+    page_in_ns,
+    paged_out_tiles, // tiles whose source features were dropped until read in again
+
+    count
+};
+
+struct Profile {
+    std::array<uint64_t, static_cast<std::size_t>(Counter::count)> values{};
+
+    uint64_t operator[](const Counter counter) const {
+        return values[static_cast<std::size_t>(counter)];
+    }
+};
+
+inline const char* counterName(const Counter counter) {
+    static const char* const names[] = {
+        "convert_calls",         "convert_ns",            "wrap_calls",
+        "wrap_ns",               "clip_x_calls",          "clip_x_ns",
+        "clip_y_calls",          "clip_y_ns",             "split_calls",
+        "split_ns",              "tile_calls",            "tile_ns",
+        "transform_calls",       "transform_ns",          "clip_trivial_accepts",
+        "clip_trivial_rejects",  "clip_feature_accepts",  "clip_feature_rejects",
+        "clip_features_clipped", "clip_points_in",        "clip_points_out",
+        "drill_downs",           "drill_ns",              "drilled_tiles",
+        "cache_hits",            "cache_misses",          "evicted_tiles",
+        "page_in_calls",         "page_in_ns",            "paged_out_tiles",
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<std::size_t>(Counter::count),
+                  "every counter needs a name");
+    return names[static_cast<std::size_t>(counter)];
+}
+
+#ifdef GEOJSONVT_PROFILE
+
+namespace detail {
+
+inline std::array<std::atomic<uint64_t>, static_cast<std::size_t>(Counter::count)>& counters() {
+    static std::array<std::atomic<uint64_t>, static_cast<std::size_t>(Counter::count)> values;
+    return values;
+}
+
+inline void count(const Counter counter, const uint64_t n) {
+    counters()[static_cast<std::size_t>(counter)].fetch_add(n, std::memory_order_relaxed);
+}
+
+// adds a call and the lifetime of the timer to a stage, given by its `_calls` counter
+class StageTimer {
+public:
+    explicit StageTimer(const Counter calls_)
+        : calls(calls_),
+          ns(static_cast<Counter>(static_cast<std::size_t>(calls_) + 1)),
+          started(std::chrono::steady_clock::now()) {
+    }
+
+    ~StageTimer() {
+        const auto elapsed = std::chrono::steady_clock::now() - started;
+        count(calls, 1);
+        count(ns, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    const Counter calls;
+    const Counter ns;
+    const std::chrono::steady_clock::time_point started;
+};
+
+struct CountPoints {
+    std::size_t operator()(const vt_point&) const {
+        return 1;
+    }
+    std::size_t operator()(const vt_geometry& geometry) const {
+        return vt_geometry::visit(geometry, *this);
+    }
+    template <class Container>
+    std::size_t operator()(const Container& container) const {
+        std::size_t n = 0;
+        for (const auto& element : container) {
+            n += (*this)(element);
+        }
+        return n;
+    }
+};
+
+inline std::size_t countPoints(const vt_geometry& geometry) {
+    return CountPoints{}(geometry);
+}
+
+} // namespace detail
+
+inline Profile getProfile() {
+    Profile profile;
+    for (std::size_t i = 0; i < profile.values.size(); ++i) {
+        profile.values[i] = detail::counters()[i].load(std::memory_order_relaxed);
+    }
+    return profile;
+}
+
+inline void resetProfile() {
+    for (auto& counter : detail::counters()) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+}
+
+// the arguments aren't evaluated at all without GEOJSONVT_PROFILE; a scope times one stage
+#define GEOJSONVT_COUNT(counter, n) ::mapbox::geojsonvt::detail::count((counter), (n))
+#define GEOJSONVT_TIME(stage) const ::mapbox::geojsonvt::detail::StageTimer geojsonvt_timer(stage)
+
+#else
+
+inline Profile getProfile() {
+    return {};
+}
+
+inline void resetProfile() {
+}
+
+#define GEOJSONVT_COUNT(counter, n) ((void)0)
+#define GEOJSONVT_TIME(stage) ((void)0)
+
+#endif
+
+} // namespace geojsonvt
+} // namespace mapbox
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <mapbox/geojsonvt/types.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+struct property_value_hash {
+    std::size_t operator()(const mapbox::geometry::null_value_t&) const {
+        return 0;
+    }
+    std::size_t operator()(const std::string& s) const {
+        return std::hash<std::string>{}(s);
+    }
+    template <class T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+    std::size_t operator()(const T& v) const {
+        return std::hash<T>{}(v);
+    }
+    // nested lists and maps are rare, so leave them to the equality check
+    template <class T, typename std::enable_if<!std::is_arithmetic<T>::value, int>::type = 0>
+    std::size_t operator()(const T&) const {
+        return 1;
+    }
+};
+
+struct identifier_hash {
+    std::size_t operator()(const identifier& id) const {
+        return identifier::visit(id, property_value_hash{});
+    }
+};
+
+/* hands out one shared copy per distinct property map, so features with the same
+ * properties (e.g. building footprints tagged only with their type) are stored once
+ * no matter how many features and tiles refer to them
+ */
+
+class PropertyPool {
+public:
+    std::shared_ptr<const property_map> intern(const property_map& properties) {
+        auto& bucket = pool[hash(properties)];
+        for (const auto& existing : bucket) {
+            if (*existing == properties)
+                return existing;
+        }
+        bucket.push_back(std::make_shared<const property_map>(properties));
+        return bucket.back();
+    }
+
+private:
+    static std::size_t hash(const property_map& properties) {
+        // entries are summed since equal maps may iterate in different orders
+        std::size_t result = properties.size();
+        for (const auto& entry : properties) {
+            const std::size_t key = std::hash<std::string>{}(entry.first);
+            const std::size_t value =
+                mapbox::geometry::value::visit(entry.second, property_value_hash{});
+            result += key ^ (value * 0x9E3779B97F4A7C15ull);
+        }
+        return result;
+    }
+
+    std::unordered_map<std::size_t, std::vector<std::shared_ptr<const property_map>>> pool;
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
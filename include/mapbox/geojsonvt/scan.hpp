@@ -0,0 +1,165 @@
+#pragma once
+
+#include <mapbox/geojsonvt/types.hpp>
+
+#include <cstddef>
+
+#if !defined(GEOJSONVT_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GEOJSONVT_SCAN_SSE2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define GEOJSONVT_SCAN_AVX2
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GEOJSONVT_SCAN_NEON
+#endif
+#endif
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+/* number of leading points whose I coordinate is within [k1, k2], used by the clipper to copy
+ * runs of points that need no intersection in one go;
+ * a point counts as inside unless it compares below k1 or above k2, like in the scalar clipper,
+ * so the vector kernels classify a block of points at a time with the same comparisons;
+ * the points are 3 doubles each, so the kernels load whole vectors of consecutive points and
+ * shuffle the I coordinates together rather than inserting them one by one;
+ * the AVX2 kernel is picked at run time when the CPU has it, SSE2 and NEON at compile time
+ * (define GEOJSONVT_NO_SIMD to always use the scalar loop)
+ */
+
+template <uint8_t I>
+inline std::size_t
+countInsideScalar(const vt_point* points, const std::size_t n, const double k1, const double k2) {
+    std::size_t i = 0;
+    for (; i < n; ++i) {
+        const double k = get<I>(points[i]);
+        if (k < k1 || k > k2)
+            break;
+    }
+    return i;
+}
+
+#if defined(GEOJSONVT_SCAN_SSE2) || defined(GEOJSONVT_SCAN_NEON)
+static_assert(sizeof(vt_point) == 3 * sizeof(double), "the scan kernels expect packed points");
+#endif
+
+#if defined(GEOJSONVT_SCAN_SSE2)
+
+// I coordinates of points p[0] and p[1]: x0 y0 | z0 x1 for x, x0 y0 | y1 z1 for y
+template <uint8_t I>
+inline __m128d loadPair(const double* p) {
+    return I == 0 ? _mm_shuffle_pd(_mm_loadu_pd(p), _mm_loadu_pd(p + 2), 2)
+                  : _mm_shuffle_pd(_mm_loadu_pd(p), _mm_loadu_pd(p + 4), 1);
+}
+
+template <uint8_t I>
+inline std::size_t
+countInsideSse2(const vt_point* points, const std::size_t n, const double k1, const double k2) {
+    const __m128d lo = _mm_set1_pd(k1);
+    const __m128d hi = _mm_set1_pd(k2);
+    std::size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        const __m128d a = loadPair<I>(&points[i].x);
+        const __m128d b = loadPair<I>(&points[i + 2].x);
+        const __m128d outA = _mm_or_pd(_mm_cmplt_pd(a, lo), _mm_cmpgt_pd(a, hi));
+        const __m128d outB = _mm_or_pd(_mm_cmplt_pd(b, lo), _mm_cmpgt_pd(b, hi));
+        const int mask = _mm_movemask_pd(outA) | (_mm_movemask_pd(outB) << 2);
+        if (mask)
+            return i + ((mask & 1) ? 0 : (mask & 2) ? 1 : (mask & 4) ? 2 : 3);
+    }
+
+    return i + countInsideScalar<I>(points + i, n - i, k1, k2);
+}
+
+#endif
+
+#if defined(GEOJSONVT_SCAN_AVX2)
+
+// I coordinates of points p[0] to p[3], from three loads of x0 y0 z0 x1 | y1 z1 x2 y2 |
+// z2 x3 y3 z3: blend them to x0 x3 x2 x1 or y1 y0 y3 y2, then put the lanes in order
+template <uint8_t I>
+__attribute__((target("avx2"))) inline __m256d loadQuad(const double* p) {
+    const __m256d a = _mm256_loadu_pd(p);
+    const __m256d b = _mm256_loadu_pd(p + 4);
+    const __m256d c = _mm256_loadu_pd(p + 8);
+    return I == 0 ? _mm256_permute4x64_pd(_mm256_blend_pd(_mm256_blend_pd(a, b, 4), c, 2),
+                                          _MM_SHUFFLE(1, 2, 3, 0))
+                  : _mm256_permute_pd(_mm256_blend_pd(_mm256_blend_pd(a, b, 9), c, 4), 5);
+}
+
+template <uint8_t I>
+__attribute__((target("avx2"))) inline std::size_t
+countInsideAvx2(const vt_point* points, const std::size_t n, const double k1, const double k2) {
+    const __m256d lo = _mm256_set1_pd(k1);
+    const __m256d hi = _mm256_set1_pd(k2);
+    std::size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        const __m256d a = loadQuad<I>(&points[i].x);
+        const __m256d b = loadQuad<I>(&points[i + 4].x);
+        const __m256d outA =
+            _mm256_or_pd(_mm256_cmp_pd(a, lo, _CMP_LT_OQ), _mm256_cmp_pd(a, hi, _CMP_GT_OQ));
+        const __m256d outB =
+            _mm256_or_pd(_mm256_cmp_pd(b, lo, _CMP_LT_OQ), _mm256_cmp_pd(b, hi, _CMP_GT_OQ));
+        const int mask = _mm256_movemask_pd(outA) | (_mm256_movemask_pd(outB) << 4);
+        if (mask)
+            return i + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+    }
+
+    return i + countInsideSse2<I>(points + i, n - i, k1, k2);
+}
+
+// checked once, the clipper calls countInside for every run
+inline bool hasAvx2() {
+#if defined(__AVX2__)
+    return true;
+#else
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#endif
+}
+
+#endif
+
+template <uint8_t I>
+inline std::size_t
+countInside(const vt_point* points, const std::size_t n, const double k1, const double k2) {
+#if defined(GEOJSONVT_SCAN_AVX2)
+    if (hasAvx2())
+        return countInsideAvx2<I>(points, n, k1, k2);
+#endif
+
+#if defined(GEOJSONVT_SCAN_SSE2)
+    return countInsideSse2<I>(points, n, k1, k2);
+
+#elif defined(GEOJSONVT_SCAN_NEON)
+    const float64x2_t lo = vdupq_n_f64(k1);
+    const float64x2_t hi = vdupq_n_f64(k2);
+    std::size_t i = 0;
+
+    // vld3q deinterleaves two points into their x, y and z
+    for (; i + 2 <= n; i += 2) {
+        const float64x2_t v = vld3q_f64(&points[i].x).val[I];
+        const uint64x2_t out = vorrq_u64(vcltq_f64(v, lo), vcgtq_f64(v, hi));
+        if (vgetq_lane_u64(out, 0))
+            return i;
+        if (vgetq_lane_u64(out, 1))
+            return i + 1;
+    }
+
+    return i + countInsideScalar<I>(points + i, n - i, k1, k2);
+
+#else
+    return countInsideScalar<I>(points, n, k1, k2);
+#endif
+}
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
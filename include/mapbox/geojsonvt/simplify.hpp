@@ -1,70 +1,193 @@
 #pragma once
 
+#include <mapbox/geojsonvt/arena.hpp>
+#include <mapbox/geojsonvt/scan.hpp>
 #include <mapbox/geojsonvt/types.hpp>
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 namespace mapbox {
 namespace geojsonvt {
 namespace detail {
 
-// square distance from a point to a segment
-inline double getSqSegDist(const vt_point& p, const vt_point& a, const vt_point& b) {
-    double x = a.x;
-    double y = a.y;
-    double dx = b.x - a.x;
-    double dy = b.y - a.y;
+// a segment a-b, with what the distance to it needs computed once for all the points of a range
+struct segment {
+    double ax, ay, bx, by;
+    double dx, dy;
+    double inv; // 1 / |b - a|², 0 when a and b are the same point
+
+    segment(const double ax_, const double ay_, const double bx_, const double by_)
+        : ax(ax_), ay(ay_), bx(bx_), by(by_), dx(bx_ - ax_), dy(by_ - ay_),
+          inv((dx != 0.0) || (dy != 0.0) ? 1.0 / (dx * dx + dy * dy) : 0.0) {
+    }
 
-    if ((dx != 0.0) || (dy != 0.0)) {
+    // square distance from point p to the segment
+    double sqDist(const double px, const double py) const {
+        double x = ax;
+        double y = ay;
 
-        const double t = ((p.x - a.x) * dx + (p.y - a.y) * dy) / (dx * dx + dy * dy);
+        if (inv != 0.0) {
+            const double t = ((px - ax) * dx + (py - ay) * dy) * inv;
 
-        if (t > 1) {
-            x = b.x;
-            y = b.y;
+            if (t > 1) {
+                x = bx;
+                y = by;
 
-        } else if (t > 0) {
-            x += dx * t;
-            y += dy * t;
+            } else if (t > 0) {
+                x += dx * t;
+                y += dy * t;
+            }
         }
-    }
 
-    dx = p.x - x;
-    dy = p.y - y;
+        const double ex = px - x;
+        const double ey = py - y;
 
-    return dx * dx + dy * dy;
+        return ex * ex + ey * ey;
+    }
+};
+
+// the coordinates of the points being simplified, in separate x and y arrays: each range is
+// scanned again at every level of the recursion, so the scans read 16 bytes a point instead of
+// the 24 of a vt_point, with packed loads, and the copy is made once for all of them; the
+// arrays come from the thread's scratch arena
+struct packed_points {
+    arena_vector<double> x;
+    arena_vector<double> y;
+    arena_vector<double> dist; // squared distances of the range being scanned
+
+    packed_points(const std::vector<vt_point>& points,
+                  const size_t first,
+                  const size_t last,
+                  Arena& arena)
+        : x(last - first + 1, 0.0, ArenaAllocator<double>(arena)),
+          y(last - first + 1, 0.0, ArenaAllocator<double>(arena)),
+          dist(last - first + 1, 0.0, ArenaAllocator<double>(arena)) {
+        for (size_t i = first; i <= last; ++i) {
+            x[i - first] = points[i].x;
+            y[i - first] = points[i].y;
+        }
+    }
+};
+
+// segment::sqDist for points [begin, end) into `dist`, with the branches turned into selects so
+// that two points are done at a time; the operations are the same, so are the results
+inline void getSqSegDists(const packed_points& points,
+                          const size_t begin,
+                          const size_t end,
+                          const segment& seg,
+                          double* dist) {
+    size_t i = begin;
+
+#if defined(GEOJSONVT_SCAN_SSE2)
+    if (seg.inv != 0.0) {
+        const __m128d vax = _mm_set1_pd(seg.ax);
+        const __m128d vay = _mm_set1_pd(seg.ay);
+        const __m128d vbx = _mm_set1_pd(seg.bx);
+        const __m128d vby = _mm_set1_pd(seg.by);
+        const __m128d vdx = _mm_set1_pd(seg.dx);
+        const __m128d vdy = _mm_set1_pd(seg.dy);
+        const __m128d inv = _mm_set1_pd(seg.inv);
+        const __m128d zero = _mm_setzero_pd();
+        const __m128d one = _mm_set1_pd(1.0);
+
+        for (; i + 2 <= end; i += 2) {
+            const __m128d px = _mm_loadu_pd(&points.x[i]);
+            const __m128d py = _mm_loadu_pd(&points.y[i]);
+            const __m128d t = _mm_mul_pd(_mm_add_pd(_mm_mul_pd(_mm_sub_pd(px, vax), vdx),
+                                                    _mm_mul_pd(_mm_sub_pd(py, vay), vdy)),
+                                         inv);
+            const __m128d far = _mm_cmpgt_pd(t, one);
+            const __m128d ahead = _mm_cmpgt_pd(t, zero);
+            const __m128d mx = _mm_add_pd(vax, _mm_mul_pd(vdx, t));
+            const __m128d my = _mm_add_pd(vay, _mm_mul_pd(vdy, t));
+            const __m128d x = _mm_or_pd(
+                _mm_and_pd(far, vbx),
+                _mm_andnot_pd(far, _mm_or_pd(_mm_and_pd(ahead, mx), _mm_andnot_pd(ahead, vax))));
+            const __m128d y = _mm_or_pd(
+                _mm_and_pd(far, vby),
+                _mm_andnot_pd(far, _mm_or_pd(_mm_and_pd(ahead, my), _mm_andnot_pd(ahead, vay))));
+            const __m128d ex = _mm_sub_pd(px, x);
+            const __m128d ey = _mm_sub_pd(py, y);
+            _mm_storeu_pd(&dist[i], _mm_add_pd(_mm_mul_pd(ex, ex), _mm_mul_pd(ey, ey)));
+        }
+    }
+#endif
+
+    for (; i < end; ++i) {
+        dist[i] = seg.sqDist(points.x[i], points.y[i]);
+    }
 }
 
-// calculate simplification data using optimized Douglas-Peucker algorithm
-inline void simplify(std::vector<vt_point>& points, size_t first, size_t last, double sqTolerance) {
-    double maxSqDist = sqTolerance;
+// index of the first point in (first, last) farthest from segment first-last, if it's farther
+// than maxSqDist, which is then updated; 0 otherwise
+inline size_t findFarthest(packed_points& points, size_t first, size_t last, double& maxSqDist) {
+    double* dist = points.dist.data();
+    const segment seg(points.x[first], points.y[first], points.x[last], points.y[last]);
+    getSqSegDists(points, first + 1, last, seg, dist);
     size_t index = 0;
 
     for (auto i = first + 1; i < last; i++) {
-        const double sqDist = getSqSegDist(points[i], points[first], points[last]);
-
-        if (sqDist > maxSqDist) {
+        if (dist[i] > maxSqDist) {
             index = i;
-            maxSqDist = sqDist;
+            maxSqDist = dist[i];
         }
     }
 
-    if (maxSqDist > sqTolerance) {
-        // save the point importance in squared pixels as a z coordinate
-        points[index].z = maxSqDist;
-        if (index - first > 1)
-            simplify(points, first, index, sqTolerance);
-        if (last - index > 1)
-            simplify(points, index, last, sqTolerance);
+    return index;
+}
+
+/* calculate simplification data using optimized Douglas-Peucker algorithm; ranges are taken from
+ * an explicit stack instead of recursing, so long rings can't overflow the call stack
+ *
+ * a point's distance is measured to the segment between the points found before it, which may
+ * be farther than the one found before it was, so keeping the points above a tolerance higher
+ * than `sqTolerance` may keep a point without the one it was found under; `monotone` caps each
+ * point's importance at that of the ends of its range instead, so that keeping the points above
+ * any tolerance gives the Douglas-Peucker simplification for that tolerance
+ */
+inline void simplify(std::vector<vt_point>& points,
+                     size_t first,
+                     size_t last,
+                     double sqTolerance,
+                     const bool monotone = false) {
+    const ArenaScope scope(scratchArena());
+    packed_points packed(points, first, last, scratchArena());
+    arena_vector<std::pair<size_t, size_t>> ranges{ ArenaAllocator<std::pair<size_t, size_t>>(
+        scratchArena()) };
+    const size_t offset = first;
+    ranges.emplace_back(first, last);
+
+    while (!ranges.empty()) {
+        first = ranges.back().first;
+        last = ranges.back().second;
+        ranges.pop_back();
+
+        double maxSqDist = sqTolerance;
+        const size_t index =
+            offset + findFarthest(packed, first - offset, last - offset, maxSqDist);
+
+        if (maxSqDist > sqTolerance) {
+            // save the point importance in squared pixels as a z coordinate
+            points[index].z =
+                monotone ? std::min({ maxSqDist, points[first].z, points[last].z }) : maxSqDist;
+            if (last - index > 1)
+                ranges.emplace_back(index, last);
+            if (index - first > 1)
+                ranges.emplace_back(first, index);
+        }
     }
 }
 
-inline void simplify(std::vector<vt_point>& points, double tolerance) {
+inline void simplify(std::vector<vt_point>& points, double tolerance, const bool monotone = false) {
     const size_t len = points.size();
 
     // always retain the endpoints (1 is the max value)
     points[0].z = 1.0;
     points[len - 1].z = 1.0;
 
-    simplify(points, 0, len - 1, tolerance * tolerance);
+    simplify(points, 0, len - 1, tolerance * tolerance, monotone);
 }
 
 } // namespace detail
@@ -0,0 +1,530 @@
+#pragma once
+
+#include <mapbox/geojsonvt/index_file.hpp>
+#include <mapbox/geojsonvt/types.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+/* a file the source features of index tiles are written out to, so they're only held in memory
+ * while tiles are drilled down from them; a tile's features are appended as one record, and the
+ * records that are written again or erased leave dead bytes behind, which are compacted away
+ * once they outnumber the live ones
+ *
+ * on the fixed-point grid of an index, x and y are stored as the zigzag varint of the difference
+ * between their grid indexes and the previous ones', which takes a byte or two for nearby points;
+ * other coordinates are stored as the difference between their bits and the previous one's, so
+ * that they're all read back as the very same values; properties are stored as the index of
+ * their map in a table of the (interned) maps of the live records, which stays in memory, and ids
+ * are stored along with the geometry
+ */
+
+class SpillWriter {
+public:
+    SpillWriter(ByteWriter& out_, const double grid_) : out(out_), grid(grid_) {
+    }
+
+    void write(const vt_geometry& geometry) {
+        vt_geometry::visit(geometry, [&](const auto& g) { this->writeSource(g); });
+    }
+
+    // the same type tags as saved tile indexes
+    void write(const optional<identifier>& id) {
+        if (!id) {
+            out.u8(0);
+            return;
+        }
+        identifier::visit(*id, [&](const auto& v) { this->writeID(v); });
+    }
+
+private:
+    ByteWriter& out;
+    const double grid;
+    int64_t lastIndex[2] = { 0, 0 };
+    uint64_t lastBits[3] = { 0, 0, 0 };
+
+    // the same geometry tags as saved tile indexes
+    void writeSource(const vt_point& p) {
+        out.u8(1);
+        writePoint(p);
+    }
+    void writeSource(const vt_line_string& line) {
+        out.u8(2);
+        writeLine(line);
+    }
+    void writeSource(const vt_polygon& polygon) {
+        out.u8(3);
+        writePolygon(polygon);
+    }
+    void writeSource(const vt_multi_point& points) {
+        out.u8(4);
+        writePoints(points);
+    }
+    void writeSource(const vt_multi_line_string& lines) {
+        out.u8(5);
+        out.varint(lines.size());
+        for (const auto& line : lines) {
+            writeLine(line);
+        }
+    }
+    void writeSource(const vt_multi_polygon& polygons) {
+        out.u8(6);
+        out.varint(polygons.size());
+        for (const auto& polygon : polygons) {
+            writePolygon(polygon);
+        }
+    }
+    void writeSource(const vt_geometry_collection& collection) {
+        out.u8(7);
+        out.varint(collection.size());
+        for (const auto& geometry : collection) {
+            write(geometry);
+        }
+    }
+
+    void writePoint(const vt_point& p) {
+        writeCoordinate(p.x, 0);
+        writeCoordinate(p.y, 1);
+        writeBits(p.z, 2);
+    }
+    void writePoints(const std::vector<vt_point>& points) {
+        out.varint(points.size());
+        for (const auto& p : points) {
+            writePoint(p);
+        }
+    }
+    void writeLine(const vt_line_string& line) {
+        writePoints(line);
+        out.f64(line.dist);
+    }
+    void writePolygon(const vt_polygon& polygon) {
+        out.varint(polygon.size());
+        for (const auto& ring : polygon) {
+            writePoints(ring);
+            out.f64(ring.area);
+        }
+    }
+
+    // with a grid, the lowest bit tells a difference of grid indexes from a coordinate that's
+    // off the grid, which follows as is
+    void writeCoordinate(const double value, const int k) {
+        if (grid == 0) {
+            writeBits(value, k);
+            return;
+        }
+        const double index = std::round(value * grid);
+        if (index / grid != value || std::abs(index) > 4503599627370496.0) {
+            out.varint(1);
+            out.f64(value);
+            return;
+        }
+        const int64_t delta = static_cast<int64_t>(index) - lastIndex[k];
+        out.varint(((static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63)) << 1);
+        lastIndex[k] = static_cast<int64_t>(index);
+    }
+
+    void writeBits(const double value, const int k) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        out.svarint(static_cast<int64_t>(bits - lastBits[k]));
+        lastBits[k] = bits;
+    }
+
+    void writeID(const mapbox::geometry::null_value_t&) {
+        out.u8(0);
+    }
+    void writeID(const uint64_t v) {
+        out.u8(2);
+        out.varint(v);
+    }
+    void writeID(const int64_t v) {
+        out.u8(3);
+        out.svarint(v);
+    }
+    void writeID(const double v) {
+        out.u8(4);
+        out.f64(v);
+    }
+    void writeID(const std::string& v) {
+        out.u8(5);
+        out.string(v);
+    }
+};
+
+class SpillReader {
+public:
+    SpillReader(ByteReader& in_, const double grid_) : in(in_), grid(grid_) {
+    }
+
+    vt_geometry read() {
+        switch (in.u8()) {
+        case 1:
+            return readPoint();
+        case 2:
+            return readLine();
+        case 3:
+            return readPolygon();
+        case 4:
+            return readPoints<vt_multi_point>();
+        case 5: {
+            vt_multi_line_string lines;
+            const std::size_t size = in.count();
+            lines.reserve(size);
+            for (std::size_t i = 0; i < size; ++i) {
+                lines.push_back(readLine());
+            }
+            return lines;
+        }
+        case 6: {
+            vt_multi_polygon polygons;
+            const std::size_t size = in.count();
+            polygons.reserve(size);
+            for (std::size_t i = 0; i < size; ++i) {
+                polygons.push_back(readPolygon());
+            }
+            return polygons;
+        }
+        case 7: {
+            vt_geometry_collection collection;
+            const std::size_t size = in.count();
+            collection.reserve(size);
+            for (std::size_t i = 0; i < size; ++i) {
+                collection.push_back(read());
+            }
+            return collection;
+        }
+        default:
+            throw std::runtime_error("Invalid spill file: unknown geometry type");
+        }
+    }
+
+    optional<identifier> readID() {
+        switch (in.u8()) {
+        case 0:
+            return {};
+        case 2:
+            return identifier{ in.varint() };
+        case 3:
+            return identifier{ in.svarint() };
+        case 4:
+            return identifier{ in.f64() };
+        case 5:
+            return identifier{ in.string() };
+        default:
+            throw std::runtime_error("Invalid spill file: unknown id type");
+        }
+    }
+
+private:
+    ByteReader& in;
+    const double grid;
+    int64_t lastIndex[2] = { 0, 0 };
+    uint64_t lastBits[3] = { 0, 0, 0 };
+
+    vt_point readPoint() {
+        const double x = readCoordinate(0);
+        const double y = readCoordinate(1);
+        const double z = readBits(2);
+        return { x, y, z };
+    }
+    template <class Points>
+    Points readPoints() {
+        Points points;
+        const std::size_t size = in.count();
+        points.reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            points.push_back(readPoint());
+        }
+        return points;
+    }
+    vt_line_string readLine() {
+        auto line = readPoints<vt_line_string>();
+        line.dist = in.f64();
+        return line;
+    }
+    vt_polygon readPolygon() {
+        vt_polygon polygon;
+        const std::size_t size = in.count();
+        polygon.reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            polygon.push_back(readPoints<vt_linear_ring>());
+            polygon.back().area = in.f64();
+        }
+        return polygon;
+    }
+
+    double readCoordinate(const int k) {
+        if (grid == 0)
+            return readBits(k);
+        const uint64_t code = in.varint();
+        if (code & 1)
+            return in.f64();
+        const uint64_t delta = code >> 1;
+        lastIndex[k] += static_cast<int64_t>(delta >> 1) ^ -static_cast<int64_t>(delta & 1);
+        return static_cast<double>(lastIndex[k]) / grid;
+    }
+
+    double readBits(const int k) {
+        lastBits[k] += static_cast<uint64_t>(in.svarint());
+        double value;
+        std::memcpy(&value, &lastBits[k], sizeof(value));
+        return value;
+    }
+};
+
+// the file is created empty and removed when it's closed; it's synchronized
+class SpillFile {
+public:
+    // dead bytes are only compacted away once there are this many of them
+    static constexpr uint64_t compact_bytes = 16 * 1024 * 1024;
+
+    // `grid_` is the fixed-point grid of the index, if any
+    explicit SpillFile(const std::string& path_,
+                       const double grid_ = 0,
+                       const uint64_t compactBytes_ = compact_bytes)
+        : path(path_), grid(grid_), compactBytes(compactBytes_) {
+        open(std::ios::trunc);
+    }
+
+    ~SpillFile() {
+        file.close();
+        std::remove(path.c_str());
+    }
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    // writes the record of a tile, in place of the one it had
+    void write(const uint64_t id, const vt_features& features) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ByteWriter out;
+        SpillWriter writer(out, grid);
+        std::vector<uint64_t> used;
+        used.reserve(features.size());
+        out.varint(features.size());
+        for (const auto& feature : features) {
+            writer.write(*feature.geometry);
+            used.push_back(propertyIndex(feature.properties));
+            out.varint(used.back());
+            writer.write(feature.id);
+        }
+        std::sort(used.begin(), used.end());
+        used.erase(std::unique(used.begin(), used.end()), used.end());
+        for (const uint64_t index : used) {
+            ++propertyUses[index];
+        }
+
+        file.seekp(static_cast<std::streamoff>(end));
+        file.write(out.data.data(), static_cast<std::streamsize>(out.data.size()));
+        if (!file) {
+            file.clear();
+            release(used);
+            throw std::runtime_error("Failed to write spill file " + path);
+        }
+        drop(id);
+        records[id] = { end, out.data.size(), std::move(used) };
+        end += out.data.size();
+        live += out.data.size();
+        compactIfNeeded();
+    }
+
+    // the tile must have a record
+    vt_features read(const uint64_t id) const {
+        std::string data;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const Extent& record = records.at(id);
+            data.resize(static_cast<std::size_t>(record.size));
+            file.seekg(static_cast<std::streamoff>(record.offset));
+            file.read(&data[0], static_cast<std::streamsize>(data.size()));
+            if (!file)
+                throw std::runtime_error("Failed to read spill file " + path);
+        }
+
+        // properties are looked up afterwards, so other threads don't wait for the decoding
+        ByteReader in(data.data(), data.size());
+        SpillReader reader(in, grid);
+        vt_features features;
+        std::vector<uint64_t> indexes;
+        const std::size_t size = in.count();
+        features.reserve(size);
+        indexes.reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            auto geometry = reader.read();
+            indexes.push_back(in.varint());
+            features.emplace_back(std::move(geometry), nullptr, reader.readID());
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (std::size_t i = 0; i < size; ++i) {
+            if (indexes[i] >= properties.size() ||
+                !properties[static_cast<std::size_t>(indexes[i])])
+                throw std::runtime_error("Invalid spill file: unknown properties");
+            features[i].properties = properties[static_cast<std::size_t>(indexes[i])];
+        }
+        return features;
+    }
+
+    bool contains(const uint64_t id) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return records.count(id) != 0;
+    }
+
+    void erase(const uint64_t id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        drop(id);
+        compactIfNeeded();
+    }
+
+    // bytes in the file, including dead ones
+    uint64_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return end;
+    }
+
+    uint64_t deadBytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return end - live;
+    }
+
+private:
+    struct Extent {
+        uint64_t offset;
+        uint64_t size;
+        // the entries of the property table the record refers to
+        std::vector<uint64_t> properties;
+    };
+
+    const std::string path;
+    const double grid;
+    const uint64_t compactBytes;
+    bool compactable = true;
+    mutable std::fstream file;
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, Extent> records;
+    uint64_t end = 0;
+    uint64_t live = 0;
+
+    // the distinct property maps of the live records, and the number of records that refer to
+    // each one; entries no record refers to anymore are freed and reused, so the table doesn't
+    // outgrow the spilled tiles; maps are told apart by address, since they're interned or shared
+    // by the copies of a feature already
+    std::vector<std::shared_ptr<const property_map>> properties;
+    std::vector<uint64_t> propertyUses;
+    std::vector<uint64_t> freeProperties;
+    std::unordered_map<const property_map*, uint64_t> propertyIndexes;
+
+    void open(const std::ios::openmode mode) {
+        file.open(path, std::ios::binary | std::ios::in | std::ios::out | mode);
+        if (!file)
+            throw std::runtime_error("Failed to open spill file " + path);
+    }
+
+    // the entry of a map, which is added without any uses if it's not in the table yet
+    uint64_t propertyIndex(const std::shared_ptr<const property_map>& map) {
+        const auto found = propertyIndexes.find(map.get());
+        if (found != propertyIndexes.end())
+            return found->second;
+        uint64_t index = properties.size();
+        if (!freeProperties.empty()) {
+            index = freeProperties.back();
+            freeProperties.pop_back();
+            properties[index] = map;
+        } else {
+            properties.push_back(map);
+            propertyUses.push_back(0);
+        }
+        propertyIndexes.emplace(map.get(), index);
+        return index;
+    }
+
+    void release(const std::vector<uint64_t>& used) {
+        for (const uint64_t index : used) {
+            if (--propertyUses[index] == 0) {
+                propertyIndexes.erase(properties[index].get());
+                properties[index].reset();
+                freeProperties.push_back(index);
+            }
+        }
+    }
+
+    void drop(const uint64_t id) {
+        const auto record = records.find(id);
+        if (record == records.end())
+            return;
+        live -= record->second.size;
+        release(record->second.properties);
+        records.erase(record);
+    }
+
+    // copies the live records over to a new file in file order
+    void compactIfNeeded() {
+        const uint64_t dead = end - live;
+        if (!compactable || dead < compactBytes || dead <= live)
+            return;
+
+        std::vector<std::pair<uint64_t, Extent*>> order;
+        order.reserve(records.size());
+        for (auto& record : records) {
+            order.emplace_back(record.second.offset, &record.second);
+        }
+        std::sort(order.begin(), order.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        const std::string compacted = path + ".compact";
+        std::vector<uint64_t> offsets;
+        offsets.reserve(order.size());
+        {
+            std::ofstream out(compacted, std::ios::binary | std::ios::trunc);
+            std::string data;
+            uint64_t offset = 0;
+            for (const auto& entry : order) {
+                data.resize(static_cast<std::size_t>(entry.second->size));
+                file.seekg(static_cast<std::streamoff>(entry.second->offset));
+                file.read(&data[0], static_cast<std::streamsize>(data.size()));
+                out.write(data.data(), static_cast<std::streamsize>(data.size()));
+                offsets.push_back(offset);
+                offset += data.size();
+            }
+            if (!file || !out) {
+                file.clear();
+                out.close();
+                std::remove(compacted.c_str());
+                throw std::runtime_error("Failed to compact spill file " + path);
+            }
+        }
+
+        // the file stays open until the new one replaced it, so if it can't be replaced, e.g.
+        // where rename doesn't replace open or existing files, the records stay where they are
+        if (std::rename(compacted.c_str(), path.c_str()) != 0) {
+            std::remove(compacted.c_str());
+            compactable = false;
+            return;
+        }
+        file.close();
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            order[i].second->offset = offsets[i];
+        }
+        end = live;
+        open(std::ios::openmode());
+    }
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+/* fork-join pool for tiling subtrees:
+ * workers take the oldest (largest) queued task from the front of the queue,
+ * while a thread waiting for its own subtasks helps out from the back,
+ * which is usually where it just pushed them
+ */
+
+class ThreadPool {
+public:
+    // the calling thread counts as one of the threads while it waits for tasks
+    explicit ThreadPool(const uint32_t threads) {
+        for (uint32_t i = 1; i < threads; ++i) {
+            workers.emplace_back([this] { this->work(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    template <class F>
+    std::future<void> push(F&& f) {
+        std::packaged_task<void()> task(std::forward<F>(f));
+        auto future = task.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(task));
+        }
+        cv.notify_one();
+        return future;
+    }
+
+    // block until all futures are ready, running queued tasks in the meantime;
+    // rethrows the first exception only once every task has finished
+    void wait(std::vector<std::future<void>>& futures) {
+        for (auto& future : futures) {
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                if (!runOne()) {
+                    future.wait();
+                }
+            }
+        }
+        for (auto& future : futures) {
+            future.get();
+        }
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::packaged_task<void()>> queue;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+
+    bool runOne() {
+        std::packaged_task<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.empty())
+                return false;
+            task = std::move(queue.back());
+            queue.pop_back();
+        }
+        task();
+        return true;
+    }
+
+    void work() {
+        while (true) {
+            std::packaged_task<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
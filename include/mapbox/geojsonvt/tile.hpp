@@ -1,64 +1,319 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mapbox/geojsonvt/feature_index.hpp>
+#include <mapbox/geojsonvt/profile.hpp>
 #include <mapbox/geojsonvt/types.hpp>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace mapbox {
 namespace geojsonvt {
 
-struct Tile {
-    mapbox::geometry::feature_collection<int16_t> features;
+// tile coordinates are signed, since the buffer lies below 0; integral ones are rounded to the
+// grid, floating point ones aren't
+template <class T>
+struct BasicTile {
+    static_assert(std::is_signed<T>::value, "tile coordinates must be a signed type");
+
+    mapbox::geometry::feature_collection<T> features;
     uint32_t num_points = 0;
     uint32_t num_simplified = 0;
 };
 
+using Tile = BasicTile<int16_t>;
+
+// rough number of bytes held by tiles, see BasicGeoJSONVT::memoryUsage
+struct MemoryUsage {
+    // the points of the source features tiles keep to drill down from, and of the clipped
+    // features lazy tiles keep until they're transformed; geometry shared by the features of
+    // several tiles is counted for each of them
+    std::size_t sourceGeometry = 0;
+
+    // the records of those features, and the spatial indexes built over them
+    std::size_t sourceFeatures = 0;
+
+    // the property maps of the output features, which each tile has its own copies of; the ones
+    // of source features are shared with the converted features, and aren't counted
+    std::size_t properties = 0;
+
+    // the output features and their geometry
+    std::size_t tileFeatures = 0;
+
+    // the bytes of encoded tiles
+    std::size_t encoded = 0;
+
+    // the tile records and the tile table's nodes holding them, and its buckets in the total
+    std::size_t tables = 0;
+
+    std::size_t total() const {
+        return sourceGeometry + sourceFeatures + properties + tileFeatures + encoded + tables;
+    }
+
+    MemoryUsage& operator+=(const MemoryUsage& other) {
+        sourceGeometry += other.sourceGeometry;
+        sourceFeatures += other.sourceFeatures;
+        properties += other.properties;
+        tileFeatures += other.tileFeatures;
+        encoded += other.encoded;
+        tables += other.tables;
+        return *this;
+    }
+};
+
 namespace detail {
 
-class InternalTile {
+// tile coordinates go from -buffer to extent + buffer, which must fit the coordinate type
+template <class T>
+inline void checkExtent(const uint16_t extent, const uint16_t buffer) {
+    if (double(extent) + buffer > double(std::numeric_limits<T>::max()))
+        throw std::runtime_error("Tile extent plus buffer doesn't fit the tile coordinates: " +
+                                 std::to_string(extent) + " + " + std::to_string(buffer));
+}
+
+// state bits of a tile's output, set under the tile's drill lock and read without one; moving it
+// is only safe while no other thread uses the tile, as when the tile moves into the tile table
+class OutputState {
+public:
+    // the output features are built, their encoded bytes are kept, the features were dropped
+    static constexpr uint8_t transformed = 1;
+    static constexpr uint8_t encoded = 2;
+    static constexpr uint8_t dropped = 4;
+
+    OutputState() = default;
+    OutputState(OutputState&& other) noexcept : bits(other.bits.load(std::memory_order_relaxed)) {
+    }
+
+    bool has(const uint8_t bit) const {
+        return (bits.load(std::memory_order_acquire) & bit) != 0;
+    }
+
+    void set(const uint8_t bit) {
+        bits.fetch_or(bit, std::memory_order_release);
+    }
+
+    void clear(const uint8_t bit) {
+        bits.fetch_and(static_cast<uint8_t>(~bit), std::memory_order_release);
+    }
+
+private:
+    std::atomic<uint8_t> bits{ transformed };
+};
+
+template <class T>
+class BasicInternalTile {
 public:
     const uint8_t z;
     const uint32_t x;
     const uint32_t y;
 
     vt_features source_features;
+    // built on the first drill-down from a tile keeping many source features, and dropped when
+    // they change
+    std::unique_ptr<const FeatureIndex> feature_index;
     bool is_solid = false;
     mapbox::geometry::box<double> bbox = { { 2, 1 }, { -1, 0 } };
 
-    Tile tile;
+    // the output tile; a lazy tile only has its point counts until `transform` builds the rest,
+    // which may happen through a const tile, e.g. when saving it
+    mutable BasicTile<T> tile;
+
+    // the bytes `encode` turned the output into, once asked for
+    mutable std::string encoded;
+
+    // what the tile was counted with in its index's memory usage when it last changed
+    mutable MemoryUsage counted;
+
+    // a lazy tile leaves its output to `transform`, keeping the features it's built from; with
+    // `maxPoints`, the output is simplified further until it fits, see fitPoints
+    //
+    // `sourceTolerance` is the one the index's source features would be simplified with: points
+    // less important than that are dropped even at max zoom, where `tolerance` is 0, so features
+    // simplified with a lower one, to be shared with finer indexes, are tiled the same
+    BasicInternalTile(const vt_features& source,
+                      const uint8_t z_,
+                      const uint32_t x_,
+                      const uint32_t y_,
+                      const uint16_t extent_,
+                      const uint16_t buffer,
+                      const double tolerance_,
+                      const bool lazy = false,
+                      const uint32_t maxPoints = 0,
+                      const double sourceTolerance = 0,
+                      const double grid_ = 0)
+        : BasicInternalTile(z_, x_, y_, extent_, tolerance_, maxPoints, sourceTolerance, grid_) {
+        GEOJSONVT_TIME(Counter::tile_calls);
+        fitPoints(source);
+        if (lazy)
+            deferFeatures(source, buffer);
+        else
+            addFeatures(source, buffer);
+    }
 
-    InternalTile(const vt_features& source,
-                 const uint8_t z_,
-                 const uint32_t x_,
-                 const uint32_t y_,
-                 const uint16_t extent_,
-                 const uint16_t buffer,
-                 const double tolerance_)
+    // an empty tile to be filled in directly, e.g. when reading a saved tile index; with the
+    // fixed-point grid of Options::fixedPoint, which the geometry must be on, the output is
+    // transformed with integer shifts (it's the same either way)
+    BasicInternalTile(const uint8_t z_,
+                      const uint32_t x_,
+                      const uint32_t y_,
+                      const uint16_t extent_,
+                      const double tolerance_,
+                      const uint32_t maxPoints = 0,
+                      const double sourceTolerance = 0,
+                      const double grid_ = 0)
         : z(z_),
           x(x_),
           y(y_),
           z2(std::pow(2, z)),
           extent(extent_),
           tolerance(tolerance_),
-          sq_tolerance(tolerance_ * tolerance_) {
+          sq_tolerance(tolerance_ * tolerance_),
+          sq_source_tolerance(sourceTolerance * sourceTolerance),
+          max_points(maxPoints),
+          threshold(tolerance_),
+          sq_threshold(sq_tolerance),
+          sq_importance(std::max(sq_tolerance, sq_source_tolerance)),
+          grid(grid_),
+          grid_origin(grid_ != 0 ? std::ilogb(grid_) - z_ : -1),
+          grid_shift(grid_ != 0 ? grid_origin - std::ilogb(extent_) : -1) {
+    }
 
+    // adds the clipped source features to the tile's output, e.g. when inserting features into
+    // an existing index; they're simplified as much as the features already there, so they may
+    // take the tile over its max points
+    void addFeatures(const vt_features& source, const uint16_t buffer) {
+        transform();
+        clearEncoded();
         for (const auto& feature : source) {
-            const auto& geom = feature.geometry;
-            const auto& props = feature.properties;
-            const auto& id = feature.id;
-
             tile.num_points += feature.num_points;
+            addFeature(feature);
+            extendBBox(feature.bbox);
+        }
 
-            vt_geometry::visit(geom, [&](const auto& g) {
-                // `this->` is a workaround for https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61636
-                this->addFeature(g, props, id);
-            });
+        is_solid = isSolid(buffer);
+    }
+
+    bool isTransformed() const {
+        return state.has(OutputState::transformed);
+    }
+
+    bool isEncoded() const {
+        return state.has(OutputState::encoded);
+    }
+
+    // builds the output of a lazy tile from the features it keeps, which it then lets go of
+    // unless they're its source features; not synchronized
+    void transform() const {
+        transform(source_features);
+    }
+
+    // the same, with `sources` standing in for the source features, e.g. when they're kept in
+    // a spill file
+    void transform(const vt_features& sources) const {
+        if (state.has(OutputState::transformed))
+            return;
+        if (state.has(OutputState::dropped))
+            throw std::runtime_error("Tile output was dropped for its encoded bytes: " +
+                                     std::to_string(z) + "/" + std::to_string(x) + "/" +
+                                     std::to_string(y));
+
+        GEOJSONVT_TIME(Counter::transform_calls);
+        const auto& features = pending.empty() ? sources : pending;
+        fitPoints(features);
+        for (const auto& feature : features) {
+            addFeature(feature);
+        }
+        vt_features().swap(pending);
+        state.set(OutputState::transformed);
+    }
+
+    // a lazy tile that hasn't been transformed yet is about to give its features away, e.g. to
+    // its children, so it keeps them to be transformed from later
+    void keepPending(const vt_features& features) {
+        if (!isTransformed())
+            pending = features;
+    }
 
-            bbox.min.x = std::min(feature.bbox.min.x, bbox.min.x);
-            bbox.min.y = std::min(feature.bbox.min.y, bbox.min.y);
-            bbox.max.x = std::max(feature.bbox.max.x, bbox.max.x);
-            bbox.max.y = std::max(feature.bbox.max.y, bbox.max.y);
+    // encodes the output with `encode(tile)`, dropping the output features afterwards if
+    // `dropOutput` is set, so the tile only keeps the bytes; not synchronized
+    template <class Encode>
+    void encode(Encode&& encode_, const bool dropOutput) const {
+        if (state.has(OutputState::encoded))
+            return;
+        transform();
+        encoded = encode_(static_cast<const BasicTile<T>&>(tile));
+        if (dropOutput) {
+            decltype(tile.features)().swap(tile.features);
+            state.set(OutputState::dropped);
+            state.clear(OutputState::transformed);
         }
+        state.set(OutputState::encoded);
+    }
+
+    // the features the output is transformed from until then, if they're no source features
+    const vt_features& pendingFeatures() const {
+        return pending;
+    }
+
+    // rough number of bytes the tile holds, besides the record itself; output points are
+    // counted from num_simplified, so it only takes a pass over the features
+    MemoryUsage memoryUsage() const {
+        MemoryUsage usage;
+        const auto addSources = [&](const vt_features& features) {
+            usage.sourceFeatures += features.size() * sizeof(vt_feature);
+            for (const auto& feature : features) {
+                usage.sourceGeometry += feature.num_points * sizeof(vt_point);
+            }
+        };
+        addSources(source_features);
+        addSources(pending);
+        if (feature_index)
+            usage.sourceFeatures += feature_index->bytes();
+
+        // the features of a tile that only keeps its encoded bytes are gone, not its counts
+        if (!tile.features.empty()) {
+            usage.tileFeatures = tile.features.size() * sizeof(tile.features.front()) +
+                                 tile.num_simplified * sizeof(mapbox::geometry::point<T>);
+        }
+        for (const auto& feature : tile.features) {
+            usage.properties += feature.properties.size() * sizeof(property_map::value_type);
+        }
+        // an empty string's capacity is inside the record
+        usage.encoded = encoded.empty() ? 0 : encoded.capacity();
+        return usage;
+    }
+
+    // removes the output and source features with the given id; `source` is their clipped
+    // geometry, and the bbox is left as it is since it only needs to cover the features
+    void removeFeatures(const identifier& id, const vt_features& source, const uint16_t buffer) {
+        transform();
+        clearEncoded();
+
+        // transforming the removed features again tells how many output points were theirs
+        const uint32_t simplified = tile.num_simplified;
+        const std::size_t size = tile.features.size();
+        for (const auto& feature : source) {
+            tile.num_points -= feature.num_points;
+            addFeature(feature);
+        }
+        tile.features.erase(tile.features.begin() + size, tile.features.end());
+        tile.num_simplified = 2 * simplified - tile.num_simplified;
+
+        const auto hasID = [&](const auto& feature) { return feature.id && *feature.id == id; };
+        tile.features.erase(std::remove_if(tile.features.begin(), tile.features.end(), hasID),
+                            tile.features.end());
+        source_features.erase(
+            std::remove_if(source_features.begin(), source_features.end(), hasID),
+            source_features.end());
+        feature_index.reset();
 
         is_solid = isSolid(buffer);
     }
@@ -68,16 +323,150 @@ private:
     const uint16_t extent;
     const double tolerance;
     const double sq_tolerance;
+    const double sq_source_tolerance;
+    const uint32_t max_points;
+
+    // the tolerance the output is simplified with, raised above `tolerance` by fitPoints, and
+    // the importance that takes for points, which is never below the source tolerance
+    mutable double threshold;
+    mutable double sq_threshold;
+    mutable double sq_importance;
+
+    // the fixed-point grid, and the bits its coordinates are shifted by to the tile's origin and
+    // down to the tile's extent (-1 without a grid)
+    const double grid;
+    const int grid_origin;
+    const int grid_shift;
+
+    mutable OutputState state;
+    mutable vt_features pending;
+
+    // leaves the output of a lazy tile to `transform`, except for what telling whether the tile
+    // is a solid square takes: its first two output features, which are all of it for most
+    // small tiles, in which case it's transformed already
+    void deferFeatures(const vt_features& source, const uint16_t buffer) {
+        std::size_t added = 0;
+        for (const auto& feature : source) {
+            tile.num_points += feature.num_points;
+            if (tile.features.size() < 2) {
+                addFeature(feature);
+                added++;
+            }
+            extendBBox(feature.bbox);
+        }
+
+        is_solid = isSolid(buffer);
+        if (added < source.size()) {
+            decltype(tile.features)().swap(tile.features);
+            tile.num_simplified = 0;
+            state.clear(OutputState::transformed);
+        }
+    }
+
+    /* raises the threshold the output's lines and rings are simplified with until it keeps at
+     * most `max_points` points: the squared distances simplify stored in the points' z tell
+     * which ones the lower zooms drop first, so the threshold is the importance of the first
+     * point over the budget, found with a partial sort
+     *
+     * points, and the line ends and clip intersections simplify and clip mark with 1, are always
+     * kept, so a tile with more of those than the budget only keeps those
+     */
+    void fitPoints(const vt_features& features) const {
+        threshold = tolerance;
+        sq_threshold = sq_tolerance;
+        sq_importance = std::max(sq_tolerance, sq_source_tolerance);
+        if (!max_points)
+            return;
+
+        std::size_t total = 0;
+        for (const auto& feature : features) {
+            total += feature.num_points;
+        }
+        if (total <= max_points)
+            return;
+
+        std::vector<double> importance;
+        std::size_t fixed = 0;
+        const auto collect = [&](const std::vector<vt_point>& points) {
+            for (const auto& p : points) {
+                if (p.z >= 1)
+                    fixed++;
+                else if (p.z > sq_importance)
+                    importance.push_back(p.z);
+            }
+        };
+        for (const auto& feature : features) {
+            fixed += countPoints(*feature.geometry, collect);
+        }
+        if (fixed + importance.size() <= max_points || importance.empty())
+            return;
+
+        const std::size_t keep = max_points > fixed ? max_points - fixed : 0;
+        std::nth_element(importance.begin(), importance.begin() + keep, importance.end(),
+                         std::greater<double>());
+        sq_threshold = importance[keep];
+        sq_importance = sq_threshold;
+        threshold = std::sqrt(sq_threshold);
+    }
 
-    bool isSolid(const uint16_t buffer) {
+    // passes the lines and rings that aren't simplified away to `collect`, returning the number
+    // of points of the point geometries
+    template <class Collect>
+    std::size_t countPoints(const vt_geometry& geometry, const Collect& collect) const {
+        std::size_t count = 0;
+        vt_geometry::visit(geometry, [&](const auto& g) { count = this->countPoints(g, collect); });
+        return count;
+    }
+    template <class Collect>
+    std::size_t countPoints(const vt_point&, const Collect&) const {
+        return 1;
+    }
+    template <class Collect>
+    std::size_t countPoints(const vt_multi_point& points, const Collect&) const {
+        return points.size();
+    }
+    template <class Collect>
+    std::size_t countPoints(const vt_line_string& line, const Collect& collect) const {
+        if (line.dist > tolerance)
+            collect(line);
+        return 0;
+    }
+    template <class Collect>
+    std::size_t countPoints(const vt_linear_ring& ring, const Collect& collect) const {
+        if (ring.area > sq_tolerance)
+            collect(ring);
+        return 0;
+    }
+    template <class U, class Collect>
+    std::size_t countPoints(const std::vector<U>& parts, const Collect& collect) const {
+        std::size_t count = 0;
+        for (const auto& part : parts) {
+            count += countPoints(part, collect);
+        }
+        return count;
+    }
+
+    void clearEncoded() {
+        std::string().swap(encoded);
+        state.clear(OutputState::encoded);
+    }
+
+    void extendBBox(const mapbox::geometry::box<double>& box) {
+        bbox.min.x = std::min(box.min.x, bbox.min.x);
+        bbox.min.y = std::min(box.min.y, bbox.min.y);
+        bbox.max.x = std::max(box.max.x, bbox.max.x);
+        bbox.max.y = std::max(box.max.y, bbox.max.y);
+    }
+
+    bool isSolid(const uint16_t buffer) const {
         if (tile.features.size() != 1)
             return false;
 
         const auto& geom = tile.features.front().geometry;
-        if (!geom.is<mapbox::geometry::polygon<int16_t>>())
+        if (!geom.template is<mapbox::geometry::polygon<T>>())
             return false;
 
-        const auto& rings = geom.get<mapbox::geometry::polygon<int16_t>>();
+        const auto& rings = geom.template get<mapbox::geometry::polygon<T>>();
         if (rings.size() > 1)
             return false;
 
@@ -85,33 +474,51 @@ private:
         if (ring.size() != 5)
             return false;
 
-        const int16_t min = -static_cast<int16_t>(buffer);
-        const int16_t max = static_cast<int16_t>(extent + buffer);
+        // floating point corners are off by the clipping error, so they're compared on the grid
+        const double min = -double(buffer);
+        const double max = double(extent) + buffer;
         for (const auto& p : ring) {
-            if ((p.x != min && p.x != max) || (p.y != min && p.y != max))
+            const double px = std::round(p.x);
+            const double py = std::round(p.y);
+            if ((px != min && px != max) || (py != min && py != max))
                 return false;
         }
 
         return true;
     }
 
-    void addFeature(const vt_point& point, const property_map& props, const optional<identifier>& id) {
+    void addFeature(const vt_feature& feature) const {
+        vt_geometry::visit(*feature.geometry, [&](const auto& g) {
+            // `this->` is a workaround for https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61636
+            this->addFeature(g, *feature.properties, feature.id);
+        });
+    }
+
+    void addFeature(const vt_point& point,
+                    const property_map& props,
+                    const optional<identifier>& id) const {
         tile.features.push_back({ transform(point), props, id });
     }
 
-    void addFeature(const vt_line_string& line, const property_map& props, const optional<identifier>& id) {
-        const auto new_line = transform(line);
+    void addFeature(const vt_line_string& line,
+                    const property_map& props,
+                    const optional<identifier>& id) const {
+        auto new_line = transform(line);
         if (!new_line.empty())
             tile.features.push_back({ std::move(new_line), props, id });
     }
 
-    void addFeature(const vt_polygon& polygon, const property_map& props, const optional<identifier>& id) {
-        const auto new_polygon = transform(polygon);
+    void addFeature(const vt_polygon& polygon,
+                    const property_map& props,
+                    const optional<identifier>& id) const {
+        auto new_polygon = transform(polygon);
         if (!new_polygon.empty())
             tile.features.push_back({ std::move(new_polygon), props, id });
     }
 
-    void addFeature(const vt_geometry_collection& collection, const property_map& props, const optional<identifier>& id) {
+    void addFeature(const vt_geometry_collection& collection,
+                    const property_map& props,
+                    const optional<identifier>& id) const {
         for (const auto& geom : collection) {
             vt_geometry::visit(geom, [&](const auto& g) {
                 // `this->` is a workaround for https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61636
@@ -120,9 +527,11 @@ private:
         }
     }
 
-    template <class T>
-    void addFeature(const T& multi, const property_map& props, const optional<identifier>& id) {
-        const auto new_multi = transform(multi);
+    template <class U>
+    void addFeature(const U& multi,
+                    const property_map& props,
+                    const optional<identifier>& id) const {
+        auto new_multi = transform(multi);
 
         switch (new_multi.size()) {
         case 0:
@@ -136,14 +545,43 @@ private:
         }
     }
 
-    mapbox::geometry::point<int16_t> transform(const vt_point& p) {
+    // number of points that survive simplification, to allocate output rings only once
+    std::size_t countRetained(const std::vector<vt_point>& points) const {
+        std::size_t count = 0;
+        for (const auto& p : points) {
+            if (p.z > sq_importance)
+                ++count;
+        }
+        return count;
+    }
+
+    mapbox::geometry::point<T> transform(const vt_point& p) const {
         ++tile.num_simplified;
-        return { static_cast<int16_t>(std::round((p.x * z2 - x) * extent)),
-                 static_cast<int16_t>(std::round((p.y * z2 - y) * extent)) };
+        if (std::is_integral<T>::value && grid_shift >= 0)
+            return { toFixedCoordinate(p.x, x), toFixedCoordinate(p.y, y) };
+        return { toCoordinate((p.x * z2 - x) * extent, std::is_integral<T>{}),
+                 toCoordinate((p.y * z2 - y) * extent, std::is_integral<T>{}) };
     }
 
-    mapbox::geometry::multi_point<int16_t> transform(const vt_multi_point& points) {
-        mapbox::geometry::multi_point<int16_t> result;
+    // a coordinate on the grid is an integer number of cells, shifted to a tile coordinate with
+    // halves rounded away from 0 like std::round does
+    T toFixedCoordinate(const double value, const uint32_t origin) const {
+        const int64_t cells = static_cast<int64_t>(value * grid) -
+                              (static_cast<int64_t>(origin) << grid_origin);
+        const int64_t half = (int64_t(1) << grid_shift) >> 1;
+        return static_cast<T>(cells >= 0 ? (cells + half) >> grid_shift
+                                         : -((half - cells) >> grid_shift));
+    }
+
+    static T toCoordinate(const double value, std::true_type) {
+        return static_cast<T>(std::round(value));
+    }
+    static T toCoordinate(const double value, std::false_type) {
+        return static_cast<T>(value);
+    }
+
+    mapbox::geometry::multi_point<T> transform(const vt_multi_point& points) const {
+        mapbox::geometry::multi_point<T> result;
         result.reserve(points.size());
         for (const auto& p : points) {
             result.push_back(transform(p));
@@ -151,50 +589,54 @@ private:
         return result;
     }
 
-    mapbox::geometry::line_string<int16_t> transform(const vt_line_string& line) {
-        mapbox::geometry::line_string<int16_t> result;
-        if (line.dist > tolerance) {
+    mapbox::geometry::line_string<T> transform(const vt_line_string& line) const {
+        mapbox::geometry::line_string<T> result;
+        if (line.dist > threshold) {
+            result.reserve(countRetained(line));
             for (const auto& p : line) {
-                if (p.z > sq_tolerance)
+                if (p.z > sq_importance)
                     result.push_back(transform(p));
             }
         }
         return result;
     }
 
-    mapbox::geometry::linear_ring<int16_t> transform(const vt_linear_ring& ring) {
-        mapbox::geometry::linear_ring<int16_t> result;
-        if (ring.area > sq_tolerance) {
+    mapbox::geometry::linear_ring<T> transform(const vt_linear_ring& ring) const {
+        mapbox::geometry::linear_ring<T> result;
+        if (ring.area > sq_threshold) {
+            result.reserve(countRetained(ring));
             for (const auto& p : ring) {
-                if (p.z > sq_tolerance)
+                if (p.z > sq_importance)
                     result.push_back(transform(p));
             }
         }
         return result;
     }
 
-    mapbox::geometry::multi_line_string<int16_t> transform(const vt_multi_line_string& lines) {
-        mapbox::geometry::multi_line_string<int16_t> result;
+    mapbox::geometry::multi_line_string<T> transform(const vt_multi_line_string& lines) const {
+        mapbox::geometry::multi_line_string<T> result;
+        result.reserve(lines.size());
         for (const auto& line : lines) {
-            if (line.dist > tolerance)
+            if (line.dist > threshold)
                 result.push_back(transform(line));
         }
         return result;
     }
 
-    mapbox::geometry::polygon<int16_t> transform(const vt_polygon& rings) {
-        mapbox::geometry::polygon<int16_t> result;
+    mapbox::geometry::polygon<T> transform(const vt_polygon& rings) const {
+        mapbox::geometry::polygon<T> result;
+        result.reserve(rings.size());
         for (const auto& ring : rings) {
-            if (ring.area > sq_tolerance)
+            if (ring.area > sq_threshold)
                 result.push_back(transform(ring));
         }
         return result;
     }
 
-    mapbox::geometry::multi_polygon<int16_t> transform(const vt_multi_polygon& polygons) {
-        mapbox::geometry::multi_polygon<int16_t> result;
+    mapbox::geometry::multi_polygon<T> transform(const vt_multi_polygon& polygons) const {
+        mapbox::geometry::multi_polygon<T> result;
         for (const auto& polygon : polygons) {
-            const auto p = transform(polygon);
+            auto p = transform(polygon);
             if (!p.empty())
                 result.push_back(std::move(p));
         }
@@ -202,6 +644,8 @@ private:
     }
 };
 
+using InternalTile = BasicInternalTile<int16_t>;
+
 } // namespace detail
 } // namespace geojsonvt
 } // namespace mapbox
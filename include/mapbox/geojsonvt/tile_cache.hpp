@@ -0,0 +1,111 @@
+#pragma once
+
+#include <mapbox/geojsonvt/tile.hpp>
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+// rough number of bytes held by clipped features
+inline std::size_t estimateBytes(const vt_features& features) {
+    std::size_t bytes = 0;
+    for (const auto& feature : features) {
+        bytes += sizeof(feature) + feature.properties->size() * sizeof(property_map::value_type) +
+                 feature.num_points * sizeof(vt_point);
+    }
+    return bytes;
+}
+
+// rough number of bytes held by a tile, counting its output, encoded bytes and source geometry
+template <class T>
+inline std::size_t estimateBytes(const BasicInternalTile<T>& tile) {
+    std::size_t bytes = sizeof(BasicInternalTile<T>) + tile.encoded.capacity();
+
+    for (const auto& feature : tile.tile.features) {
+        bytes += sizeof(feature) + feature.properties.size() * sizeof(property_map::value_type);
+        mapbox::geometry::for_each_point(feature.geometry, [&](const auto& p) {
+            bytes += sizeof(p);
+        });
+    }
+    return bytes + estimateBytes(tile.source_features) + estimateBytes(tile.pendingFeatures());
+}
+
+// recency order and sizes of the tiles that may be evicted; not synchronized
+class TileCache {
+public:
+    // a tile that's cached already is resized and touched instead
+    void add(const uint64_t id, const std::size_t size) {
+        if (touch(id)) {
+            resize(id, size);
+            return;
+        }
+        order.push_front(id);
+        entries.emplace(id, Entry{ order.begin(), size });
+        total_bytes += size;
+    }
+
+    // marks the tile as most recently used; false if it isn't cached
+    bool touch(const uint64_t id) {
+        const auto it = entries.find(id);
+        if (it == entries.end())
+            return false;
+        order.splice(order.begin(), order, it->second.position);
+        return true;
+    }
+
+    // sets the size of a cached tile whose contents changed, e.g. once it's transformed
+    void resize(const uint64_t id, const std::size_t size) {
+        const auto it = entries.find(id);
+        if (it == entries.end())
+            return;
+        total_bytes = total_bytes - it->second.bytes + size;
+        it->second.bytes = size;
+    }
+
+    bool contains(const uint64_t id) const {
+        return entries.count(id) != 0;
+    }
+
+    void remove(const uint64_t id) {
+        const auto it = entries.find(id);
+        if (it == entries.end())
+            return;
+        total_bytes -= it->second.bytes;
+        order.erase(it->second.position);
+        entries.erase(it);
+    }
+
+    std::size_t size() const {
+        return entries.size();
+    }
+
+    std::size_t bytes() const {
+        return total_bytes;
+    }
+
+    // least recently used first
+    std::list<uint64_t>::const_reverse_iterator begin() const {
+        return order.crbegin();
+    }
+    std::list<uint64_t>::const_reverse_iterator end() const {
+        return order.crend();
+    }
+
+private:
+    struct Entry {
+        std::list<uint64_t>::iterator position;
+        std::size_t bytes;
+    };
+
+    std::list<uint64_t> order; // most recently used first
+    std::unordered_map<uint64_t, Entry> entries;
+    std::size_t total_bytes = 0;
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
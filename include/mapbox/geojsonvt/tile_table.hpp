@@ -0,0 +1,361 @@
+#pragma once
+
+#include <mapbox/geojsonvt/tile.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+// reader-writer spin lock for short critical sections: an uncontended lock is a single atomic
+// add, while std::shared_timed_mutex costs more than the hash lookup it would guard
+class SharedSpinLock {
+public:
+    void lock() {
+        uint32_t expected = 0;
+        while (!state.compare_exchange_weak(expected, writer, std::memory_order_acquire)) {
+            expected = 0;
+            std::this_thread::yield();
+        }
+    }
+
+    // readers waiting for the lock have bumped the count meanwhile and take it back themselves,
+    // so only the writer bit is cleared
+    void unlock() {
+        state.fetch_sub(writer, std::memory_order_release);
+    }
+
+    void lock_shared() {
+        while (state.fetch_add(1, std::memory_order_acquire) & writer) {
+            state.fetch_sub(1, std::memory_order_relaxed);
+            while (state.load(std::memory_order_relaxed) & writer) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void unlock_shared() {
+        state.fetch_sub(1, std::memory_order_release);
+    }
+
+private:
+    static constexpr uint32_t writer = 1u << 31;
+    std::atomic<uint32_t> state{ 0 };
+};
+
+/* tile storage keyed by tile id, split into independently locked shards:
+ * lookups take a shared lock on a single shard, so readers of cached tiles
+ * only ever wait for an insertion into the same shard;
+ * tiles are never moved once inserted, so references to them stay valid until erased
+ */
+
+template <class T>
+class BasicTileTable {
+public:
+    static constexpr std::size_t shard_count = 64;
+
+    using map_type = std::unordered_map<uint64_t, BasicInternalTile<T>>;
+    using value_type = typename map_type::value_type;
+
+    // bytes a tile takes in the table besides what it holds: its node, with the link to the next
+    static constexpr std::size_t node_bytes = sizeof(value_type) + sizeof(void*);
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename BasicTileTable::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        reference operator*() const {
+            return *it;
+        }
+        pointer operator->() const {
+            return &*it;
+        }
+        const_iterator& operator++() {
+            ++it;
+            skipEmpty();
+            return *this;
+        }
+        const_iterator operator++(int) {
+            auto result = *this;
+            ++(*this);
+            return result;
+        }
+        bool operator==(const const_iterator& other) const {
+            return shard == other.shard && (shard == shard_count || it == other.it);
+        }
+        bool operator!=(const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class BasicTileTable;
+
+        const_iterator(const BasicTileTable& table_, std::size_t shard_)
+            : table(&table_), shard(shard_) {
+            if (shard < shard_count) {
+                it = table->shards[shard].tiles.begin();
+                skipEmpty();
+            }
+        }
+
+        const_iterator(const BasicTileTable& table_,
+                       std::size_t shard_,
+                       typename map_type::const_iterator it_)
+            : table(&table_), shard(shard_), it(it_) {
+        }
+
+        void skipEmpty() {
+            while (it == table->shards[shard].tiles.end()) {
+                if (++shard == shard_count)
+                    return;
+                it = table->shards[shard].tiles.begin();
+            }
+        }
+
+        const BasicTileTable* table;
+        std::size_t shard;
+        typename map_type::const_iterator it;
+    };
+
+    BasicTileTable() = default;
+    BasicTileTable(const BasicTileTable&) = delete;
+    BasicTileTable& operator=(const BasicTileTable&) = delete;
+
+    BasicInternalTile<T>* find(const uint64_t id) {
+        auto& shard = shards[shardIndex(id)];
+        shard.mutex.lock_shared();
+        const auto it = shard.tiles.find(id);
+        auto* tile = it == shard.tiles.end() ? nullptr : &it->second;
+        shard.mutex.unlock_shared();
+        return tile;
+    }
+
+    const BasicInternalTile<T>* find(const uint64_t id) const {
+        return const_cast<BasicTileTable*>(this)->find(id);
+    }
+
+    // the same, storing the id in `pin` if the tile is found; that happens under the shard's
+    // lock, so an eraseUnless running at the same time either sees the pin or erases the tile
+    // before it can be found. The store releases the tile pinned before, so that whoever sees
+    // it gone also sees the reads of it done
+    BasicInternalTile<T>* find(const uint64_t id, std::atomic<uint64_t>& pin) {
+        auto& shard = shards[shardIndex(id)];
+        shard.mutex.lock_shared();
+        const auto it = shard.tiles.find(id);
+        auto* tile = it == shard.tiles.end() ? nullptr : &it->second;
+        if (tile)
+            pin.store(id, std::memory_order_release);
+        shard.mutex.unlock_shared();
+        return tile;
+    }
+
+    const BasicInternalTile<T>& at(const uint64_t id) const {
+        const auto* tile = find(id);
+        if (!tile)
+            throw std::out_of_range("Tile not found");
+        return *tile;
+    }
+
+    std::size_t count(const uint64_t id) const {
+        return find(id) ? 1 : 0;
+    }
+
+    // inserts the tile unless one with the same id is already stored; returns the stored tile
+    std::pair<BasicInternalTile<T>*, bool> emplace(const uint64_t id, BasicInternalTile<T>&& tile) {
+        auto& shard = shards[shardIndex(id)];
+        std::lock_guard<SharedSpinLock> lock(shard.mutex);
+        const auto result = shard.tiles.emplace(id, std::move(tile));
+        return { &result.first->second, result.second };
+    }
+
+    bool erase(const uint64_t id) {
+        auto& shard = shards[shardIndex(id)];
+        std::lock_guard<SharedSpinLock> lock(shard.mutex);
+        return shard.tiles.erase(id) != 0;
+    }
+
+    // erases a tile unless `keep(tile)` returns true, which is called under the shard's lock;
+    // false if the tile is kept or isn't stored
+    template <class Keep>
+    bool eraseUnless(const uint64_t id, Keep&& keep) {
+        auto& shard = shards[shardIndex(id)];
+        std::lock_guard<SharedSpinLock> lock(shard.mutex);
+        const auto it = shard.tiles.find(id);
+        if (it == shard.tiles.end() || keep(it->second))
+            return false;
+        shard.tiles.erase(it);
+        return true;
+    }
+
+    std::size_t size() const {
+        std::size_t result = 0;
+        for (auto& shard : shards) {
+            shard.mutex.lock_shared();
+            result += shard.tiles.size();
+            shard.mutex.unlock_shared();
+        }
+        return result;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // bytes of the shards' bucket arrays
+    std::size_t bucketBytes() const {
+        std::size_t result = 0;
+        for (auto& shard : shards) {
+            shard.mutex.lock_shared();
+            result += shard.tiles.bucket_count() * sizeof(void*);
+            shard.mutex.unlock_shared();
+        }
+        return result;
+    }
+
+    // iteration is not synchronized with concurrent insertions
+    const_iterator begin() const {
+        return { *this, 0 };
+    }
+    const_iterator end() const {
+        return { *this, shard_count };
+    }
+
+    // the position of a tile for iterating from it, or end() if it isn't stored
+    const_iterator position(const uint64_t id) const {
+        const std::size_t index = shardIndex(id);
+        auto& shard = shards[index];
+        shard.mutex.lock_shared();
+        const auto it = shard.tiles.find(id);
+        const bool found = it != shard.tiles.end();
+        shard.mutex.unlock_shared();
+        return found ? const_iterator(*this, index, it) : end();
+    }
+
+    static std::size_t shardIndex(const uint64_t id) {
+        // the low bits of a tile id hold the zoom, so spread them with a multiplicative hash
+        return static_cast<std::size_t>((id * 0x9E3779B97F4A7C15ull) >> 58) % shard_count;
+    }
+
+private:
+    struct Shard {
+        mutable SharedSpinLock mutex;
+        map_type tiles;
+    };
+
+    std::array<Shard, shard_count> shards;
+};
+
+using TileTable = BasicTileTable<int16_t>;
+
+// the tile each thread last looked up in an index, for evictions to leave alone, so that the
+// reference the thread got stays good until its next lookup; a thread keeps its slot until the
+// index goes away, pinning at most one tile even after it exits
+class TilePins {
+public:
+    static constexpr uint64_t none = std::numeric_limits<uint64_t>::max();
+
+    TilePins() = default;
+    TilePins(const TilePins&) = delete;
+    TilePins& operator=(const TilePins&) = delete;
+
+    // the calling thread's slot, which it stores the ids it looks up in
+    std::atomic<uint64_t>& slot() {
+        // the slot a thread used last, by the serial number of its index, which isn't reused
+        // the way the address of a destroyed index can be
+        thread_local std::pair<uint64_t, std::atomic<uint64_t>*> last{ 0, nullptr };
+        if (last.first == serial)
+            return *last.second;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& pin = slots.emplace(std::piecewise_construct,
+                                  std::forward_as_tuple(std::this_thread::get_id()),
+                                  std::forward_as_tuple(uint64_t(none)))
+                        .first->second;
+        last = { serial, &pin };
+        return pin;
+    }
+
+    bool contains(const uint64_t id) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& pin : slots) {
+            if (pin.second.load(std::memory_order_acquire) == id)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    static uint64_t nextSerial() {
+        static std::atomic<uint64_t> next{ 1 };
+        return next++;
+    }
+
+    const uint64_t serial = nextSerial();
+    mutable std::mutex mutex;
+    std::unordered_map<std::thread::id, std::atomic<uint64_t>> slots;
+};
+
+// the tiles of an index as getInternalTiles returns them: a read-only map from tile id to tile,
+// iterated in no particular order; not synchronized with concurrent insertions
+template <class T>
+class BasicTileView {
+public:
+    using key_type = uint64_t;
+    using mapped_type = BasicInternalTile<T>;
+    using value_type = typename BasicTileTable<T>::value_type;
+    using const_iterator = typename BasicTileTable<T>::const_iterator;
+    using iterator = const_iterator;
+    using size_type = std::size_t;
+
+    explicit BasicTileView(const BasicTileTable<T>& table_) : table(&table_) {
+    }
+
+    const_iterator begin() const {
+        return table->begin();
+    }
+    const_iterator end() const {
+        return table->end();
+    }
+
+    const_iterator find(const uint64_t id) const {
+        return table->position(id);
+    }
+
+    const mapped_type& at(const uint64_t id) const {
+        return table->at(id);
+    }
+
+    size_type count(const uint64_t id) const {
+        return table->count(id);
+    }
+
+    size_type size() const {
+        return table->size();
+    }
+
+    bool empty() const {
+        return table->empty();
+    }
+
+private:
+    const BasicTileTable<T>* table;
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
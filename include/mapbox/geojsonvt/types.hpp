@@ -4,6 +4,8 @@
 #include <mapbox/variant.hpp>
 
 #include <algorithm>
+#include <cmath>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -56,6 +58,12 @@ inline vt_point intersect<1>(const vt_point& a, const vt_point& b, const double
     return { x, y, 1.0 };
 }
 
+// the nearest multiple of 1 / grid, for coordinates kept on a fixed-point grid; a grid of 0
+// leaves them as they are
+inline double snapToGrid(const double value, const double grid) {
+    return grid != 0 ? std::round(value * grid) / grid : value;
+}
+
 using vt_multi_point = std::vector<vt_point>;
 
 struct vt_line_string : std::vector<vt_point> {
@@ -129,17 +137,31 @@ struct vt_geometry_type<geometry::geometry_collection<double>> {
 };
 
 struct vt_feature {
-    vt_geometry geometry;
-    property_map properties;
+    // geometry and properties never change once a feature is built, so the copies of a feature
+    // kept by different tiles share them
+    std::shared_ptr<const vt_geometry> geometry;
+    std::shared_ptr<const property_map> properties;
     optional<identifier> id;
 
     mapbox::geometry::box<double> bbox = { { 2, 1 }, { -1, 0 } };
     uint32_t num_points = 0;
 
-    vt_feature(const vt_geometry& geom, const property_map& props, const optional<identifier>& id_)
-        : geometry(geom), properties(props), id(id_) {
+    vt_feature(vt_geometry geom, const property_map& props, const optional<identifier>& id_)
+        : vt_feature(std::move(geom), std::make_shared<const property_map>(props), id_) {
+    }
+
+    vt_feature(vt_geometry geom,
+               std::shared_ptr<const property_map> props,
+               const optional<identifier>& id_)
+        : geometry(std::make_shared<const vt_geometry>(std::move(geom))),
+          properties(std::move(props)),
+          id(id_) {
+        processGeometry();
+    }
 
-        mapbox::geometry::for_each_point(geom, [&](const vt_point& p) {
+private:
+    void processGeometry() {
+        mapbox::geometry::for_each_point(*geometry, [&](const vt_point& p) {
             bbox.min.x = std::min(p.x, bbox.min.x);
             bbox.min.y = std::min(p.y, bbox.min.y);
             bbox.max.x = std::max(p.x, bbox.max.x);
@@ -1,42 +1,53 @@
 #pragma once
 
 #include <mapbox/geojsonvt/clip.hpp>
+#include <mapbox/geojsonvt/profile.hpp>
 #include <mapbox/geojsonvt/types.hpp>
 
+#include <iterator>
+#include <memory>
+
 namespace mapbox {
 namespace geojsonvt {
 namespace detail {
 
 inline void shiftCoords(vt_features& features, double offset) {
     for (auto& feature : features) {
-        mapbox::geometry::for_each_point(feature.geometry,
+        // the geometry may be shared with the feature it was clipped from, so shift a copy
+        auto geometry = std::make_shared<vt_geometry>(*feature.geometry);
+        mapbox::geometry::for_each_point(*geometry,
                                          [offset](vt_point& point) { point.x += offset; });
+        feature.geometry = std::move(geometry);
         feature.bbox.min.x += offset;
         feature.bbox.max.x += offset;
     }
 }
 
-inline vt_features wrap(const vt_features& features, double buffer) {
+inline vt_features wrap(const vt_features& features, double buffer, const double grid = 0) {
+    GEOJSONVT_TIME(Counter::wrap_calls);
+
     // left world copy
-    auto left = clip<0>(features, -1 - buffer, buffer, -1, 2);
+    auto left = clip<0>(features, -1 - buffer, buffer, -1, 2, grid);
     // right world copy
-    auto right = clip<0>(features, 1 - buffer, 2 + buffer, -1, 2);
+    auto right = clip<0>(features, 1 - buffer, 2 + buffer, -1, 2, grid);
 
     if (left.empty() && right.empty())
         return features;
 
     // center world copy
-    auto merged = clip<0>(features, -buffer, 1 + buffer, -1, 2);
+    auto merged = clip<0>(features, -buffer, 1 + buffer, -1, 2, grid);
 
     if (!left.empty()) {
         // merge left into center
         shiftCoords(left, 1.0);
-        merged.insert(merged.begin(), left.begin(), left.end());
+        merged.insert(merged.begin(), std::make_move_iterator(left.begin()),
+                      std::make_move_iterator(left.end()));
     }
     if (!right.empty()) {
         // merge right into center
         shiftCoords(right, -1.0);
-        merged.insert(merged.end(), right.begin(), right.end());
+        merged.insert(merged.end(), std::make_move_iterator(right.begin()),
+                      std::make_move_iterator(right.end()));
     }
     return merged;
 }
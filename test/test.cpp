@@ -3,16 +3,33 @@
 #include <mapbox/geojson.hpp>
 #include <mapbox/geojson_impl.hpp>
 #include <mapbox/geojsonvt.hpp>
+#include <mapbox/geojsonvt/arena.hpp>
 #include <mapbox/geojsonvt/clip.hpp>
 #include <mapbox/geojsonvt/convert.hpp>
+#include <mapbox/geojsonvt/mvt.hpp>
+#include <mapbox/geojsonvt/points.hpp>
+#include <mapbox/geojsonvt/scan.hpp>
 #include <mapbox/geojsonvt/simplify.hpp>
+#include <mapbox/geojsonvt/spill.hpp>
 #include <mapbox/geojsonvt/tile.hpp>
+#include <mapbox/geojsonvt/wrap.hpp>
 #include <mapbox/geometry.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <vector>
 
 using namespace mapbox::geojsonvt;
@@ -79,6 +96,20 @@ TEST(Simplify, Points) {
     }
 
     ASSERT_EQ(result, simplified);
+
+    // monotone importance keeps the simplification for any higher tolerance
+    for (const double tolerance : { 0.002, 0.005, 0.01, 0.03 }) {
+        auto monotone = points;
+        auto exact = points;
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            monotone[i].z = exact[i].z = 0;
+        }
+        detail::simplify(monotone, 0.001, true);
+        detail::simplify(exact, tolerance);
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            ASSERT_EQ(monotone[i].z > tolerance * tolerance, exact[i].z > 0);
+        }
+    }
 }
 
 TEST(Clip, Polylines) {
@@ -176,6 +207,201 @@ TEST(Clip, Points) {
     ASSERT_EQ(expected2, clipped2);
 }
 
+TEST(Clip, InsideRuns) {
+    // every position of the first point outside [10, 40], including ones on the edges and NaN
+    const double outside[] = { 5, 45, 9.999, 40.001, -INFINITY, INFINITY };
+    const double inside[] = { 10, 40, 25, NAN };
+
+    for (std::size_t n = 0; n < 20; ++n) {
+        for (std::size_t cut = 0; cut <= n; ++cut) {
+            for (const double out : outside) {
+                std::vector<detail::vt_point> points;
+                for (std::size_t i = 0; i < n; ++i) {
+                    const double k = i < cut ? inside[i % 4] : i == cut ? out : 25;
+                    points.emplace_back(k, 50 - k);
+                }
+                const auto expected = detail::countInsideScalar<0>(points.data(), n, 10, 40);
+                ASSERT_EQ(cut, expected);
+                ASSERT_EQ(expected, detail::countInside<0>(points.data(), n, 10, 40));
+                ASSERT_EQ(detail::countInsideScalar<1>(points.data(), n, 10, 40),
+                          detail::countInside<1>(points.data(), n, 10, 40));
+#if defined(GEOJSONVT_SCAN_SSE2)
+                ASSERT_EQ(expected, detail::countInsideSse2<0>(points.data(), n, 10, 40));
+                ASSERT_EQ(detail::countInsideScalar<1>(points.data(), n, 10, 40),
+                          detail::countInsideSse2<1>(points.data(), n, 10, 40));
+#endif
+#if defined(GEOJSONVT_SCAN_AVX2)
+                if (detail::hasAvx2()) {
+                    ASSERT_EQ(expected, detail::countInsideAvx2<0>(points.data(), n, 10, 40));
+                    ASSERT_EQ(detail::countInsideScalar<1>(points.data(), n, 10, 40),
+                              detail::countInsideAvx2<1>(points.data(), n, 10, 40));
+                }
+#endif
+            }
+        }
+    }
+
+    const detail::vt_line_string line{ { 0, 0 },  { 20, 2 }, { 30, 3 }, { 40, 4 },
+                                       { 20, 5 }, { 15, 6 }, { 35, 7 } };
+    const detail::vt_geometry expected{ detail::vt_line_string{
+        { 10, 1 }, { 20, 2 }, { 30, 3 }, { 40, 4 }, { 20, 5 }, { 15, 6 }, { 35, 7 } } };
+    ASSERT_EQ(expected, (detail::clipper<0>{ 10, 40 }(line)));
+}
+
+TEST(Clip, SharedFeatures) {
+    const detail::property_map props{ { "name", std::string("a") } };
+    const detail::vt_features features{
+        { detail::vt_line_string{ { 0.1, 0.1 }, { 0.2, 0.2 } }, props, {} },
+        { detail::vt_line_string{ { 0.1, 0.3 }, { 0.9, 0.3 } }, props, {} }
+    };
+
+    // trivially accepted features share their geometry and properties, clipped ones only the latter
+    const auto clipped = detail::clip<0>(features, 0, 0.5, 0.1, 0.9);
+    ASSERT_EQ(2u, clipped.size());
+    ASSERT_EQ(features[0].geometry, clipped[0].geometry);
+    ASSERT_EQ(features[0].properties, clipped[0].properties);
+    ASSERT_NE(features[1].geometry, clipped[1].geometry);
+    ASSERT_EQ(features[1].properties, clipped[1].properties);
+
+    // shifting world copies leaves the features they were clipped from alone
+    const auto wrapped = detail::wrap(features, 0.95);
+    ASSERT_EQ(0.1, features[0].bbox.min.x);
+    ASSERT_EQ(0.1, features[0].geometry->get<detail::vt_line_string>()[0].x);
+    ASSERT_LT(features.size(), wrapped.size());
+}
+
+TEST(Clip, Quadrants) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"))
+                             .get<mapbox::geojson::feature_collection>();
+    auto features = detail::wrap(detail::convert(geojson, 1e-8), 64.0 / 4096);
+    // an empty feature leaves boxes that are both inside and outside every bound
+    features.push_back({ detail::vt_polygon{}, detail::property_map{}, {} });
+
+    mapbox::geometry::box<double> bbox = { { 2, 1 }, { -1, 0 } };
+    for (const auto& feature : features) {
+        bbox.min.x = std::min(feature.bbox.min.x, bbox.min.x);
+        bbox.min.y = std::min(feature.bbox.min.y, bbox.min.y);
+        bbox.max.x = std::max(feature.bbox.max.x, bbox.max.x);
+        bbox.max.y = std::max(feature.bbox.max.y, bbox.max.y);
+    }
+
+    // the quadrants of tiles the states cross at several zooms, and of the empty feature alone
+    const std::vector<std::pair<detail::vt_features, std::array<uint32_t, 3>>> cases{
+        { features, { { 0, 0, 0 } } },
+        { features, { { 3, 1, 2 } } },
+        { features, { { 5, 7, 12 } } },
+        { { features.back() }, { { 2, 1, 1 } } },
+    };
+    for (const auto& c : cases) {
+        const double z2 = 1u << c.second[0];
+        const double x = c.second[1];
+        const double y = c.second[2];
+        const double p = 32.0 / 4096;
+        const detail::split_bounds xs = { { { (x - p) / z2, (x + 0.5 + p) / z2 },
+                                            { (x + 0.5 - p) / z2, (x + 1 + p) / z2 } } };
+        const detail::split_bounds ys = { { { (y - p) / z2, (y + 0.5 + p) / z2 },
+                                            { (y + 0.5 - p) / z2, (y + 1 + p) / z2 } } };
+        const auto& box = c.first.size() == 1 ? c.first.front().bbox : bbox;
+        const auto quadrants = detail::splitQuadrants(c.first, xs, ys, box);
+
+        for (uint8_t i = 0; i < 4; ++i) {
+            const auto& column = xs[i / 2];
+            const auto& row = ys[i % 2];
+            const auto strip = detail::clip<0>(c.first, column[0], column[1], box.min.x, box.max.x);
+            const auto expected = detail::clip<1>(strip, row[0], row[1], box.min.y, box.max.y);
+            ASSERT_EQ(expected.size(), quadrants[i].size());
+            for (std::size_t j = 0; j < expected.size(); ++j) {
+                ASSERT_EQ(*expected[j].geometry, *quadrants[i][j].geometry);
+                ASSERT_EQ(expected[j].properties, quadrants[i][j].properties);
+                ASSERT_EQ(expected[j].bbox.min, quadrants[i][j].bbox.min);
+                ASSERT_EQ(expected[j].bbox.max, quadrants[i][j].bbox.max);
+            }
+        }
+    }
+}
+
+TEST(Clip, ScratchArena) {
+    const std::size_t block = detail::Arena::block_size;
+    const std::size_t retained = detail::Arena::retained;
+    detail::Arena arena;
+    {
+        const detail::ArenaScope outer(arena);
+        detail::arena_vector<double> a{ detail::ArenaAllocator<double>(arena) };
+        a.assign(100, 1.0);
+        const auto* first = a.data();
+        {
+            // what's allocated in a scope is handed out again after it
+            const detail::ArenaScope inner(arena);
+            detail::arena_vector<detail::vt_point> b{ detail::ArenaAllocator<detail::vt_point>(
+                arena) };
+            b.assign(3 * block, { 0, 0 });
+            ASSERT_GE(arena.capacity(), 4 * block);
+        }
+        detail::arena_vector<double> c{ detail::ArenaAllocator<double>(arena) };
+        c.assign(10, 2.0);
+        ASSERT_EQ(first + 100, c.data());
+        ASSERT_EQ(1.0, a.back());
+
+        // blocks in use are never freed
+        arena.release(0);
+        ASSERT_GT(arena.capacity(), 0u);
+    }
+    // the big block goes, the first one stays for the next scratch
+    arena.release();
+    ASSERT_EQ(block, arena.capacity());
+    arena.release(0);
+    ASSERT_EQ(0u, arena.capacity());
+
+    // the index gives back the scratch it clipped and simplified with past what's retained
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT index{ geojson };
+    ASSERT_LE(detail::scratchArena().capacity(), retained);
+    ASSERT_FALSE(index.getTile(9, 145, 193).features.empty());
+    ASSERT_LE(detail::scratchArena().capacity(), retained);
+}
+
+TEST(Convert, SharedProperties) {
+    const mapbox::geometry::point<double> point{ 0, 0 };
+    const mapbox::geometry::feature_collection<double> features{
+        { point, { { "building", std::string("yes") } } },
+        { point, { { "building", std::string("yes") } } },
+        { point, { { "building", std::string("no") } } },
+        { point, {} }
+    };
+
+    const auto converted = detail::convert(features, 0);
+    ASSERT_EQ(4u, converted.size());
+    ASSERT_EQ(converted[0].properties, converted[1].properties);
+    ASSERT_NE(converted[0].properties, converted[2].properties);
+    ASSERT_NE(converted[0].properties, converted[3].properties);
+    ASSERT_EQ(features[2].properties, *converted[2].properties);
+    ASSERT_TRUE(converted[3].properties->empty());
+}
+
+TEST(Convert, Parallel) {
+    const auto features = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"))
+                              .get<mapbox::geojson::feature_collection>();
+    const auto serial = detail::convert(features, 1e-8);
+    detail::ThreadPool pool(3);
+    const auto parallel = detail::convert(features, 1e-8, pool, 7);
+
+    ASSERT_EQ(serial.size(), parallel.size());
+    for (std::size_t i = 0; i < serial.size(); ++i) {
+        ASSERT_EQ(*serial[i].geometry == *parallel[i].geometry, true);
+        ASSERT_EQ(*serial[i].properties, *parallel[i].properties);
+        ASSERT_EQ(serial[i].id, parallel[i].id);
+        ASSERT_EQ(serial[i].num_points, parallel[i].num_points);
+    }
+}
+
+void expectSameTile(const Tile& a, const Tile& b) {
+    ASSERT_EQ(a.features.size(), b.features.size());
+    ASSERT_EQ(a == b, true);
+    for (std::size_t i = 0; i < a.features.size(); ++i) {
+        ASSERT_EQ(a.features[i].geometry == b.features[i].geometry, true);
+    }
+}
+
 TEST(GetTile, USStates) {
     const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
     GeoJSONVT index{ geojson.get<mapbox::geojson::feature_collection>() };
@@ -195,6 +421,39 @@ TEST(GetTile, USStates) {
     // ASSERT_EQ(isEmpty(index.getTile(-5, 123.25, 400.25)), true); // invalid tile
 
     ASSERT_EQ(37, index.total);
+
+    // only the zooms that have tiles are listed
+    uint32_t counted = 0;
+    for (const auto& stat : index.getStats()) {
+        ASSERT_GT(stat.second, 0u);
+        counted += stat.second;
+    }
+    ASSERT_EQ(counted, index.total);
+
+    // `stats` reads like the map it used to be
+    const std::map<uint8_t, uint32_t> stats = index.stats;
+    ASSERT_EQ(stats, index.getStats());
+    ASSERT_EQ(index.stats.size(), stats.size());
+    ASSERT_EQ(index.stats[0], 1u);
+    ASSERT_EQ(index.stats[12], 0u);
+    ASSERT_EQ(index.stats.count(12), 0u);
+    ASSERT_EQ(index.stats.find(12) == index.stats.end(), true);
+    ASSERT_EQ(index.stats.find(1)->second, index.stats.at(1));
+    ASSERT_THROW(index.stats.at(12), std::out_of_range);
+    auto stat = stats.begin();
+    for (const auto& zoom : index.stats) {
+        ASSERT_EQ(zoom.first, stat->first);
+        ASSERT_EQ(zoom.second, stat->second);
+        ++stat;
+    }
+    ASSERT_EQ(stat == stats.end(), true);
+
+    const auto tiles = index.getInternalTiles();
+    ASSERT_EQ(tiles.size(), index.total);
+    ASSERT_EQ(tiles.find(toID(1, 0, 0))->first, toID(1, 0, 0));
+    ASSERT_EQ(tiles.find(toID(1, 0, 0))->second.z, 1);
+    ASSERT_EQ(tiles.find(toID(11, 800, 400)) == tiles.end(), true);
+    ASSERT_EQ(tiles.count(toID(11, 800, 400)), 0u);
 }
 
 TEST(GetTile, AntimeridianTriangle) {
@@ -281,6 +540,1303 @@ TEST(GetTile, Projection) {
     }
 }
 
+TEST(GetTile, ParallelIndex) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    Options options;
+    options.indexMaxZoom = 7;
+    options.indexMaxPoints = 200;
+    GeoJSONVT serial{ geojson, options };
+
+    options.threads = 4;
+    GeoJSONVT parallel{ geojson, options };
+
+    ASSERT_EQ(serial.total, parallel.total);
+    ASSERT_EQ(serial.getStats(), parallel.getStats());
+
+    for (const auto& pair : serial.getInternalTiles()) {
+        const auto& tile = pair.second;
+        const auto& other = parallel.getInternalTiles().at(pair.first);
+        ASSERT_EQ(tile.tile == other.tile, true);
+        ASSERT_EQ(tile.source_features.size(), other.source_features.size());
+    }
+
+    ASSERT_EQ(serial.getTile(9, 148, 192) == parallel.getTile(9, 148, 192), true);
+}
+
+TEST(GetTile, Concurrent) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT serial{ geojson };
+    GeoJSONVT concurrent{ geojson };
+
+    struct TileCoordinate {
+        uint8_t z;
+        uint32_t x;
+        uint32_t y;
+    };
+
+    std::vector<TileCoordinate> tileCoordinates;
+    for (uint32_t x = 32; x < 48; ++x) {
+        for (uint32_t y = 40; y < 56; ++y) {
+            tileCoordinates.push_back({ 7, x, y });
+            tileCoordinates.push_back({ 9, x * 4 + 1, y * 4 + 2 });
+        }
+    }
+
+    // every thread requests the same tiles, starting at a different offset
+    std::vector<std::thread> threads;
+    std::vector<std::vector<const Tile*>> results(4);
+    for (std::size_t t = 0; t < results.size(); ++t) {
+        threads.emplace_back([&, t] {
+            for (std::size_t i = 0; i < tileCoordinates.size(); ++i) {
+                const auto& c = tileCoordinates[(i + t * 37) % tileCoordinates.size()];
+                results[t].push_back(&concurrent.getTile(c.z, c.x, c.y));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (std::size_t t = 0; t < results.size(); ++t) {
+        for (std::size_t i = 0; i < tileCoordinates.size(); ++i) {
+            const auto& c = tileCoordinates[(i + t * 37) % tileCoordinates.size()];
+            ASSERT_EQ(serial.getTile(c.z, c.x, c.y) == *results[t][i], true);
+        }
+    }
+
+    ASSERT_EQ(serial.total, concurrent.total);
+    for (const auto& pair : serial.getStats()) {
+        ASSERT_EQ(pair.second, concurrent.getStats().at(pair.first));
+    }
+}
+
+TEST(GetTile, ConcurrentEviction) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT serial{ geojson };
+
+    // a cache this small evicts tiles on nearly every call, some of them lazy ones that another
+    // thread is about to transform or compare
+    Options options;
+    options.maxCachedTiles = 4;
+    options.lazyTiles = true;
+    GeoJSONVT cached{ geojson, options };
+
+    std::vector<std::array<uint32_t, 3>> tileCoordinates;
+    for (uint32_t x = 36; x < 40; ++x) {
+        for (uint32_t y = 44; y < 50; ++y) {
+            tileCoordinates.push_back({ { 8, x * 2, y * 2 + 1 } });
+            tileCoordinates.push_back({ { 9, x * 4 + 1, y * 4 + 2 } });
+        }
+    }
+
+    // each thread reads every tile it gets before its next call, which is how long it's pinned
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (int pass = 0; pass < 3; ++pass) {
+                for (std::size_t i = 0; i < tileCoordinates.size(); ++i) {
+                    const auto& c = tileCoordinates[(i + t * 7) % tileCoordinates.size()];
+                    const Tile& tile = cached.getTile(c[0], c[1], c[2]);
+                    EXPECT_EQ(tile == serial.getTile(c[0], c[1], c[2]), true);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_LT(cached.getInternalTiles().size(), serial.getInternalTiles().size());
+}
+
+TEST(GetTile, Async) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT serial{ geojson };
+    Options options;
+    options.asyncThreads = 3;
+    GeoJSONVT async{ geojson, options };
+
+    // index tiles are passed back right away
+    auto root = async.getTileAsync(0, 0, 0);
+    ASSERT_EQ(root.wait_for(std::chrono::seconds(0)) == std::future_status::ready, true);
+    ASSERT_EQ(serial.getTile(0, 0, 0) == root.get(), true);
+
+    // bursts of requests for the same tiles and their siblings, merged into fewer drill-downs
+    std::vector<std::pair<std::array<uint32_t, 3>, std::shared_future<const Tile&>>> requests;
+    for (uint32_t x = 32; x < 48; x += 3) {
+        for (uint32_t y = 40; y < 56; y += 3) {
+            for (int i = 0; i < 3; ++i) {
+                requests.emplace_back(std::array<uint32_t, 3>{ { 9, x * 4 + 1, y * 4 + 2 } },
+                                      async.getTileAsync(9, x * 4 + 1, y * 4 + 2));
+                requests.emplace_back(std::array<uint32_t, 3>{ { 10, x * 8 + 3, y * 8 } },
+                                      async.getTileAsync(10, x * 8 + 3, y * 8));
+            }
+        }
+    }
+    for (auto& request : requests) {
+        const auto& c = request.first;
+        ASSERT_EQ(serial.getTile(c[0], c[1], c[2]) == request.second.get(), true);
+    }
+    ASSERT_EQ(serial.total, async.total);
+
+    // drilled-down tiles are passed back right away too, and errors through the callback
+    const auto& tiles = async.getInternalTiles();
+    const auto drilled = std::find_if(tiles.begin(), tiles.end(), [&](const auto& pair) {
+        return pair.second.z > options.indexMaxZoom;
+    });
+    ASSERT_EQ(drilled != tiles.end(), true);
+    const auto& t = drilled->second;
+    std::atomic<bool> called{ false };
+    async.getTileAsync(t.z, t.x, t.y, [&](const Tile& tile, std::exception_ptr error) {
+        called = !error && serial.getTile(t.z, t.x, t.y) == tile;
+    });
+    ASSERT_EQ(called.load(), true);
+    ASSERT_THROW(async.getTileAsync(options.maxZoom + 1, 0, 0), std::runtime_error);
+}
+
+TEST(GetTile, LazyIndex) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.indexMaxZoom = 7;
+    options.indexMaxPoints = 200;
+    GeoJSONVT eager{ geojson, options };
+
+    options.indexMaxZoom = 0;
+    options.maxCachedTiles = 50;
+    GeoJSONVT lazy{ geojson, options };
+    ASSERT_EQ(lazy.getInternalTiles().size(), 1u);
+
+    for (const auto& pair : eager.getInternalTiles()) {
+        const auto& tile = pair.second;
+        expectSameTile(lazy.getTile(tile.z, tile.x, tile.y), tile.tile);
+    }
+    expectSameTile(lazy.getTile(9, 148, 192), eager.getTile(9, 148, 192));
+    ASSERT_LT(lazy.getInternalTiles().size(), eager.getInternalTiles().size());
+}
+
+TEST(GetTile, Region) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.indexMaxZoom = 4;
+    options.indexMaxPoints = 200;
+    GeoJSONVT index{ geojson, options };
+    GeoJSONVT reference{ geojson, options };
+    index.getTile(6, 14, 24);
+    const auto indexTiles = index.getInternalTiles().size();
+
+    std::size_t count = 0;
+    index.getTiles(2, 9, { { -110, 30 }, { -95, 42 } },
+                   [&](uint8_t z, uint32_t x, uint32_t y, const Tile& tile) {
+                       expectSameTile(tile, reference.getTile(z, x, y));
+                       count++;
+                   });
+
+    std::size_t expected = 0;
+    for (uint8_t z = 2; z <= 9; ++z) {
+        const double z2 = 1u << z;
+        const auto tileX = [&](double lng) { return std::floor((lng / 360 + 0.5) * z2); };
+        const auto tileY = [&](double lat) {
+            const double sine = std::sin(lat * M_PI / 180);
+            return std::floor((0.5 - 0.25 * std::log((1 + sine) / (1 - sine)) / M_PI) * z2);
+        };
+        expected += (tileX(-95) - tileX(-110) + 1) * (tileY(30) - tileY(42) + 1);
+    }
+    ASSERT_EQ(count, expected);
+    ASSERT_EQ(index.getInternalTiles().size(), indexTiles);
+}
+
+TEST(GetTile, LazyTiles) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.indexMaxZoom = 7;
+    options.indexMaxPoints = 200;
+    GeoJSONVT eager{ geojson, options };
+
+    options.lazyTiles = true;
+    GeoJSONVT lazy{ geojson, options };
+    ASSERT_EQ(lazy.getInternalTiles().size(), eager.getInternalTiles().size());
+    std::size_t transformed = 0;
+    for (const auto& pair : lazy.getInternalTiles()) {
+        transformed += pair.second.isTransformed();
+    }
+    ASSERT_LT(transformed, lazy.getInternalTiles().size());
+
+    for (const auto& pair : eager.getInternalTiles()) {
+        const auto& tile = pair.second;
+        expectSameTile(lazy.getTile(tile.z, tile.x, tile.y), tile.tile);
+        ASSERT_TRUE(lazy.getInternalTiles().at(pair.first).isTransformed());
+    }
+    expectSameTile(lazy.getTile(9, 148, 192), eager.getTile(9, 148, 192));
+
+    GeoJSONVT walked{ geojson, options };
+    walked.getTiles(0, 9, { { -110, 30 }, { -95, 42 } },
+                    [&](uint8_t z, uint32_t x, uint32_t y, const Tile& tile) {
+                        expectSameTile(tile, eager.getTile(z, x, y));
+                    });
+}
+
+TEST(GetTile, FixedPoint) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    const auto& features = geojson.get<mapbox::geojson::feature_collection>();
+    Options options;
+    options.maxZoom = 14;
+    options.indexMaxZoom = 7;
+    options.indexMaxPoints = 200;
+    options.fixedPoint = true;
+    GeoJSONVT index{ geojson, options };
+    const double grid = std::ldexp(1.0, 14 + 12);
+
+    std::size_t checked = 0;
+    for (const auto& pair : index.getInternalTiles()) {
+        const auto& tile = pair.second;
+        // the clipped geometry stays on the grid
+        for (const auto& feature : tile.source_features) {
+            mapbox::geometry::for_each_point(*feature.geometry, [&](const detail::vt_point& p) {
+                EXPECT_EQ(std::round(p.x * grid), p.x * grid);
+                EXPECT_EQ(std::round(p.y * grid), p.y * grid);
+            });
+        }
+        // and shifting it gives the same tile as rounding the transformed coordinates
+        const detail::BasicInternalTile<int16_t> shifted(tile.source_features, tile.z, tile.x,
+                                                         tile.y, 4096, 64, 0, false, 0, 0, grid);
+        const detail::BasicInternalTile<int16_t> rounded(tile.source_features, tile.z, tile.x,
+                                                         tile.y, 4096, 64, 0);
+        expectSameTile(shifted.tile, rounded.tile);
+        checked += !tile.source_features.empty();
+    }
+    ASSERT_GT(checked, 0u);
+    ASSERT_FALSE(index.getTile(14, 4661, 6183).features.empty());
+
+    // the grid needs a power of 2 extent and must fit 32 bits
+    options.extent = 4000;
+    ASSERT_THROW(GeoJSONVT(geojson, options), std::runtime_error);
+    options.extent = 4096;
+    options.maxZoom = 24;
+    ASSERT_THROW(GeoJSONVT(geojson, options), std::runtime_error);
+
+    // features shared through a store must be on the index's grid
+    options.maxZoom = 14;
+    Options plain = options;
+    plain.fixedPoint = false;
+    const FeatureStore store{ features, { plain } };
+    ASSERT_THROW(GeoJSONVT(store, options), std::runtime_error);
+    const FeatureStore fixed{ features, { options } };
+    GeoJSONVT shared{ fixed, options };
+    expectSameTile(shared.getTile(9, 145, 193), index.getTile(9, 145, 193));
+
+    // features added one by one are snapped the same way
+    GeoJSONVT::Builder builder{ options };
+    for (const auto& feature : features) {
+        builder.addFeature(feature);
+    }
+    const auto built = builder.build();
+    for (uint8_t z = 0; z <= 7; ++z) {
+        const uint32_t z2 = 1u << z;
+        for (uint32_t x = 0; x < z2; ++x) {
+            for (uint32_t y = 0; y < z2; ++y) {
+                expectSameTile(built->getTile(z, x, y), index.getTile(z, x, y));
+            }
+        }
+    }
+
+    // a saved index still drills down on the grid once it's loaded
+    const std::string path = "test-fixed-point.gjvt";
+    built->save(path);
+    {
+        auto loaded = GeoJSONVT::load(path);
+        for (uint8_t z = 8; z <= 14; ++z) {
+            const uint32_t x = 4722 >> (14 - z);
+            const uint32_t y = 6264 >> (14 - z);
+            for (uint32_t dx = 0; dx < 3; ++dx) {
+                for (uint32_t dy = 0; dy < 3; ++dy) {
+                    expectSameTile(loaded->getTile(z, x + dx - 1, y + dy - 1),
+                                   index.getTile(z, x + dx - 1, y + dy - 1));
+                }
+            }
+        }
+    }
+    std::remove(path.c_str());
+}
+
+TEST(GetTile, MaxPointsPerTile) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.indexMaxZoom = 7;
+    options.indexMaxPoints = 200;
+    GeoJSONVT full{ geojson, options };
+
+    options.maxPointsPerTile = 100;
+    GeoJSONVT bounded{ geojson, options };
+    options.lazyTiles = true;
+    GeoJSONVT lazy{ geojson, options };
+
+    // tiles over the budget drop their least important points, the others stay as they were
+    std::size_t reduced = 0;
+    for (const auto& pair : full.getInternalTiles()) {
+        const auto& tile = pair.second;
+        const auto& fitted = bounded.getTile(tile.z, tile.x, tile.y);
+        ASSERT_EQ(fitted.num_points, tile.tile.num_points);
+        ASSERT_LE(fitted.num_simplified, 100u);
+        if (tile.tile.num_simplified > 100u) {
+            ASSERT_LT(fitted.features.size() + fitted.num_simplified,
+                      tile.tile.features.size() + tile.tile.num_simplified);
+            reduced++;
+        } else {
+            expectSameTile(fitted, tile.tile);
+        }
+        expectSameTile(lazy.getTile(tile.z, tile.x, tile.y), fitted);
+    }
+    ASSERT_GT(reduced, 0u);
+    ASSERT_LE(bounded.getTile(9, 148, 192).num_simplified, 100u);
+
+    const std::string path = "test-index-max-points.gjvt";
+    bounded.save(path);
+    auto loaded = GeoJSONVT::load(path);
+    ASSERT_EQ(loaded->options.maxPointsPerTile, 100u);
+    expectSameTile(loaded->getTile(10, 296, 385), bounded.getTile(10, 296, 385));
+    std::remove(path.c_str());
+}
+
+TEST(GetTile, SharedFeatures) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    const auto& features = geojson.get<mapbox::geojson::feature_collection>();
+    Options fine;
+    fine.indexMaxZoom = 7;
+    fine.indexMaxPoints = 200;
+    fine.maxZoom = 12;
+    Options coarse;
+    coarse.maxZoom = 5;
+    coarse.extent = 512;
+    coarse.buffer = 16;
+    const FeatureStore store{ features, { coarse, fine } };
+    ASSERT_EQ(store.tolerance, detail::sourceTolerance(fine));
+
+    const auto expectSameTiles = [](GeoJSONVT& a, GeoJSONVT& b) {
+        ASSERT_EQ(a.getInternalTiles().size(), b.getInternalTiles().size());
+        for (const auto& pair : b.getInternalTiles()) {
+            const auto& tile = pair.second;
+            expectSameTile(a.getTile(tile.z, tile.x, tile.y), tile.tile);
+        }
+        a.getTiles(0, a.options.maxZoom, { { -77, 37 }, { -76, 39 } },
+                   [&](uint8_t z, uint32_t x, uint32_t y, const Tile& tile) {
+                       expectSameTile(tile, b.getTile(z, x, y));
+                   });
+    };
+
+    // an index tiles the store the same whatever other indexes it's shared with, and at max zoom
+    // the same as its own conversion
+    for (const auto& options : { fine, coarse }) {
+        GeoJSONVT shared{ store, options };
+        GeoJSONVT alone{ FeatureStore{ features, { options } }, options };
+        expectSameTiles(shared, alone);
+
+        GeoJSONVT own{ features, options };
+        shared.getTiles(options.maxZoom, options.maxZoom, { { -77, 37 }, { -76, 39 } },
+                        [&](uint8_t z, uint32_t x, uint32_t y, const Tile& tile) {
+                            expectSameTile(tile, own.getTile(z, x, y));
+                        });
+    }
+
+    // a filtered index only takes the features passing it
+    const auto firstHalf = [](const mapbox::geometry::property_map& properties) {
+        return properties.at("name").get<std::string>() < "M";
+    };
+    mapbox::geojson::feature_collection filtered;
+    for (const auto& feature : features) {
+        if (firstHalf(feature.properties))
+            filtered.push_back(feature);
+    }
+    ASSERT_LT(filtered.size(), features.size());
+    GeoJSONVT shared{ store, fine, firstHalf };
+    GeoJSONVT alone{ FeatureStore{ filtered, { fine } }, fine };
+    expectSameTiles(shared, alone);
+
+    // an index keeping more detail than the store has
+    Options finer = fine;
+    finer.maxZoom = 14;
+    ASSERT_THROW((GeoJSONVT{ store, finer }), std::runtime_error);
+}
+
+TEST(GetTile, Eviction) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT reference{ geojson };
+
+    const std::size_t limit = 10;
+    Options options;
+    options.maxCachedTiles = limit;
+    GeoJSONVT cached{ geojson, options };
+
+    options.maxCachedTiles = 0;
+    options.maxCacheBytes = 200000;
+    GeoJSONVT sized{ geojson, options };
+
+    const auto indexTiles = cached.getInternalTiles().size();
+
+    // go over the same tiles twice, so that the second pass regenerates evicted tiles
+    for (int pass = 0; pass < 2; ++pass) {
+        for (uint32_t x = 36; x < 40; ++x) {
+            for (uint32_t y = 44; y < 50; ++y) {
+                for (uint8_t dz = 0; dz < 3; ++dz) {
+                    const uint32_t m = 1u << dz;
+                    const Tile tile = cached.getTile(7 + dz, x * m + dz, y * m);
+                    const Tile other = sized.getTile(7 + dz, x * m + dz, y * m);
+                    ASSERT_EQ(reference.getTile(7 + dz, x * m + dz, y * m) == tile, true);
+                    ASSERT_EQ(tile == other, true);
+                    // the requested tile and its cached descendants are never evicted, but
+                    // there are at most 1 + 4 + 4 of them here, fewer than the limit
+                    ASSERT_LE(cached.getInternalTiles().size(), indexTiles + limit);
+                }
+            }
+        }
+    }
+
+    ASSERT_LT(cached.getInternalTiles().size(), reference.getInternalTiles().size());
+    ASSERT_LT(sized.getInternalTiles().size(), reference.getInternalTiles().size());
+}
+
+TEST(GetTile, DrillIndex) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT reference{ geojson };
+
+    // only the top tile is indexed, and it gets a spatial index however few features it has
+    Options options;
+    options.indexMaxZoom = 0;
+    options.maxCachedTiles = 10;
+    options.drillIndexFeatures = 1;
+    GeoJSONVT indexed{ geojson, options };
+
+    for (int pass = 0; pass < 2; ++pass) {
+        for (uint32_t x = 36; x < 40; ++x) {
+            for (uint32_t y = 44; y < 50; ++y) {
+                for (uint8_t dz = 0; dz < 3; ++dz) {
+                    const uint32_t m = 1u << dz;
+                    const Tile tile = indexed.getTile(7 + dz, x * m + dz, y * m);
+                    ASSERT_EQ(reference.getTile(7 + dz, x * m + dz, y * m) == tile, true);
+                }
+            }
+        }
+    }
+
+    // the index finds the features overlapping a box, as checking each of them would
+    const auto& root = indexed.getInternalTiles().find(0)->second;
+    ASSERT_TRUE(root.feature_index != nullptr);
+    const auto& features = root.source_features;
+    for (const double size : { 0.001, 0.01, 0.1 }) {
+        for (double x = 0.1; x < 0.35; x += 0.02) {
+            const mapbox::geometry::box<double> box{ { x, 0.35 }, { x + size, 0.4 + size } };
+            std::vector<uint32_t> expected;
+            for (uint32_t i = 0; i < features.size(); ++i) {
+                const auto& b = features[i].bbox;
+                if (b.min.x <= box.max.x && b.max.x >= box.min.x && b.min.y <= box.max.y &&
+                    b.max.y >= box.min.y)
+                    expected.push_back(i);
+            }
+            ASSERT_EQ(expected, root.feature_index->query(box));
+        }
+    }
+}
+
+TEST(GetTile, SaveLoad) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.indexMaxZoom = 4;
+    options.indexMaxPoints = 200;
+    GeoJSONVT index{ geojson, options };
+    GeoJSONVT reference{ geojson, options };
+
+    // drilled-down tiles are saved too
+    index.getTile(7, 37, 48);
+
+    const std::string path = "test-index.gjvt";
+    index.save(path);
+    auto loaded = GeoJSONVT::load(path);
+    ASSERT_EQ(loaded->getInternalTiles().size(), 0u);
+    ASSERT_EQ(loaded->options.indexMaxPoints, 200u);
+    ASSERT_EQ(loaded->total, index.total);
+
+    for (uint8_t z = 0; z < 9; ++z) {
+        const uint32_t z2 = 1u << z;
+        for (uint32_t x = z2 * 9 / 32; x < z2 * 10 / 32 + 1; ++x) {
+            for (uint32_t y = z2 * 11 / 32; y < z2 * 13 / 32 + 1; ++y) {
+                ASSERT_EQ(loaded->getTile(z, x, y) == reference.getTile(z, x, y), true);
+            }
+        }
+    }
+
+    // saving a loaded index keeps the tiles that were never looked up
+    loaded->save(path);
+    auto reloaded = GeoJSONVT::load(path);
+    ASSERT_EQ(reloaded->getTile(3, 0, 2) == reference.getTile(3, 0, 2), true);
+    ASSERT_EQ(reloaded->getTile(7, 37, 48) == reference.getTile(7, 37, 48), true);
+
+    // equal properties of decoded source features are shared, as they are in a built index
+    {
+        const detail::IndexFile file(path);
+        std::vector<detail::InternalTile> decoded;
+        std::map<std::string, const detail::property_map*> shared;
+        std::size_t features = 0;
+        for (std::size_t i = 0; i < file.size(); ++i) {
+            decoded.push_back(file.decode<int16_t>(file.idAt(i), 0));
+            for (const auto& feature : decoded.back().source_features) {
+                const auto& name = feature.properties->at("name").get<std::string>();
+                ASSERT_EQ(shared.emplace(name, feature.properties.get()).first->second,
+                          feature.properties.get());
+                ++features;
+            }
+        }
+        ASSERT_LT(shared.size(), features);
+    }
+
+    std::ofstream(path, std::ios::binary) << "GJVT";
+    ASSERT_THROW(GeoJSONVT::load(path), std::runtime_error);
+    std::remove(path.c_str());
+
+#ifdef GEOJSONVT_MMAP
+    // an index that can't be moved into place leaves no temporary file behind
+    const std::string blocked = "test-index-blocked";
+    ASSERT_EQ(::mkdir(blocked.c_str(), 0700), 0);
+    std::ofstream(blocked + "/file") << "x";
+    ASSERT_THROW(index.save(blocked), std::runtime_error);
+    ASSERT_FALSE(std::ifstream(blocked + ".tmp").good());
+    std::remove((blocked + "/file").c_str());
+    std::remove(blocked.c_str());
+#endif
+}
+
+TEST(GetTile, Spill) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.indexMaxZoom = 4;
+    options.indexMaxPoints = 200;
+    GeoJSONVT reference{ geojson, options };
+
+    const std::string path = "test-spill.bin";
+    options.spillPath = path;
+    options.spillResidentBytes = 1;
+    options.maxCachedTiles = 20;
+    {
+        GeoJSONVT index{ geojson, options };
+        std::size_t points = 0;
+        std::vector<uint64_t> indexTiles;
+        for (const auto& pair : reference.getInternalTiles()) {
+            for (const auto& feature : pair.second.source_features) {
+                points += feature.num_points;
+            }
+            ASSERT_TRUE(index.getInternalTiles().at(pair.first).source_features.empty());
+            indexTiles.push_back(pair.first);
+        }
+        // coordinates take less than the 24 bytes a point holds in memory
+        const auto spilled = std::ifstream(path, std::ios::binary | std::ios::ate).tellg();
+        ASSERT_GT(spilled, 0);
+        ASSERT_LT(static_cast<std::size_t>(spilled), points * 24);
+
+        for (uint8_t z = 0; z < 10; ++z) {
+            const uint32_t z2 = 1u << z;
+            for (uint32_t x = z2 * 9 / 32; x < z2 * 10 / 32 + 1; ++x) {
+                for (uint32_t y = z2 * 11 / 32; y < z2 * 13 / 32 + 1; ++y) {
+                    expectSameTile(index.getTile(z, x, y), reference.getTile(z, x, y));
+                }
+            }
+        }
+        // the features read back in were dropped again right away
+        for (const uint64_t id : indexTiles) {
+            ASSERT_TRUE(index.getInternalTiles().at(id).source_features.empty());
+        }
+
+        const mapbox::geometry::feature<double> feature{ mapbox::geometry::point<double>{ -105,
+                                                                                          39 } };
+        index.insert(feature);
+        reference.insert(feature);
+        expectSameTile(index.getTile(8, 53, 97), reference.getTile(8, 53, 97));
+        expectSameTile(index.getTile(4, 3, 6), reference.getTile(4, 3, 6));
+
+        const std::string saved = "test-spill.gjvt";
+        index.save(saved);
+        auto loaded = GeoJSONVT::load(saved);
+        expectSameTile(loaded->getTile(7, 26, 48), reference.getTile(7, 26, 48));
+        std::remove(saved.c_str());
+    }
+    ASSERT_FALSE(std::ifstream(path).good());
+
+    // on the fixed-point grid, x and y take a byte or two each
+    options.fixedPoint = true;
+    options.spillPath.clear();
+    GeoJSONVT fixedReference{ geojson, options };
+    options.spillPath = path;
+    {
+        GeoJSONVT index{ geojson, options };
+        std::size_t points = 0;
+        for (const auto& pair : fixedReference.getInternalTiles()) {
+            for (const auto& feature : pair.second.source_features) {
+                points += feature.num_points;
+            }
+        }
+        const auto spilled = std::ifstream(path, std::ios::binary | std::ios::ate).tellg();
+        ASSERT_LT(static_cast<std::size_t>(spilled), points * 16);
+        for (uint32_t x = 72; x < 76; ++x) {
+            for (uint32_t y = 94; y < 100; ++y) {
+                expectSameTile(index.getTile(8, x, y), fixedReference.getTile(8, x, y));
+            }
+        }
+    }
+}
+
+TEST(GetTile, SpillRecords) {
+    const double grid = 1 << 20;
+    const auto shared = std::make_shared<const detail::property_map>(
+        detail::property_map{ { "name", std::string("a") } });
+    const detail::vt_features features{
+        { detail::vt_line_string{ { 0.25, 0.5, 1 }, { 0.25 + 3 / grid, 0.5 - 1 / grid, 0.125 } },
+          shared,
+          mapbox::geometry::identifier{ uint64_t(7) } },
+        // off the grid
+        { detail::vt_point{ 0.1, -0.2 }, shared, mapbox::geometry::identifier{ std::string("b") } },
+        { detail::vt_multi_point{ { -0.5, 1.5 } }, detail::property_map{}, {} },
+    };
+    const auto points = [](const detail::vt_features& fs) {
+        std::vector<std::array<double, 3>> result;
+        for (const auto& feature : fs) {
+            mapbox::geometry::for_each_point(*feature.geometry, [&](const detail::vt_point& p) {
+                result.push_back({ { p.x, p.y, p.z } });
+            });
+        }
+        return result;
+    };
+    const auto expectSameFeatures = [&](const detail::vt_features& read) {
+        ASSERT_EQ(read.size(), features.size());
+        ASSERT_EQ(points(read), points(features));
+        for (std::size_t i = 0; i < read.size(); ++i) {
+            // properties are the very maps that were written
+            ASSERT_EQ(read[i].properties, features[i].properties);
+            ASSERT_EQ(read[i].id, features[i].id);
+            ASSERT_EQ(read[i].num_points, features[i].num_points);
+        }
+    };
+
+    const std::string path = "test-spill-records.bin";
+    {
+        detail::SpillFile spill(path, grid, 1);
+        spill.write(1, features);
+        const uint64_t size = spill.size();
+        expectSameFeatures(spill.read(1));
+
+        // records written again or erased are dead until they outnumber the live ones
+        spill.write(2, features);
+        spill.write(1, features);
+        ASSERT_EQ(spill.size(), 3 * size);
+        ASSERT_EQ(spill.deadBytes(), size);
+        expectSameFeatures(spill.read(1));
+
+        spill.erase(2);
+        ASSERT_FALSE(spill.contains(2));
+        ASSERT_EQ(spill.size(), size);
+        ASSERT_EQ(spill.deadBytes(), 0u);
+        const auto compacted = std::ifstream(path, std::ios::binary | std::ios::ate).tellg();
+        ASSERT_EQ(static_cast<uint64_t>(compacted), size);
+        expectSameFeatures(spill.read(1));
+
+#ifdef GEOJSONVT_MMAP
+        // a compaction that fails leaves the records where they were
+        const std::string blocked = path + ".compact";
+        ASSERT_EQ(::mkdir(blocked.c_str(), 0700), 0);
+        spill.write(1, features);
+        ASSERT_THROW(spill.write(1, features), std::runtime_error);
+        std::remove(blocked.c_str());
+        ASSERT_EQ(spill.deadBytes(), 2 * size);
+        expectSameFeatures(spill.read(1));
+#endif
+
+        // property maps are only kept while a record refers to them
+        std::weak_ptr<const detail::property_map> released;
+        {
+            const auto own = std::make_shared<const detail::property_map>(
+                detail::property_map{ { "name", std::string("c") } });
+            released = own;
+            spill.write(3, { { detail::vt_point{ 0.5, 0.5 }, own, {} } });
+        }
+        ASSERT_FALSE(released.expired());
+        spill.write(3, features);
+        ASSERT_TRUE(released.expired());
+        expectSameFeatures(spill.read(3));
+        spill.erase(1);
+        expectSameFeatures(spill.read(3));
+    }
+    ASSERT_FALSE(std::ifstream(path).good());
+}
+
+// the memory usage an index keeps up to date, against the one counted from all of its tiles
+static void expectCountedMemory(const GeoJSONVT& index) {
+    std::map<uint8_t, MemoryUsage> counted;
+    for (const auto& pair : index.getInternalTiles()) {
+        auto usage = pair.second.memoryUsage();
+        usage.tables = detail::TileTable::node_bytes;
+        counted[pair.second.z] += usage;
+    }
+    for (const auto& zoom : index.memoryUsage()) {
+        const auto& expected = counted[zoom.first];
+        ASSERT_EQ(zoom.second.sourceGeometry, expected.sourceGeometry);
+        ASSERT_EQ(zoom.second.sourceFeatures, expected.sourceFeatures);
+        ASSERT_EQ(zoom.second.properties, expected.properties);
+        ASSERT_EQ(zoom.second.tileFeatures, expected.tileFeatures);
+        ASSERT_EQ(zoom.second.encoded, expected.encoded);
+        ASSERT_EQ(zoom.second.tables, expected.tables);
+    }
+}
+
+TEST(GetTile, MemoryUsage) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.indexMaxZoom = 4;
+    options.indexMaxPoints = 200;
+    options.lazyTiles = true;
+    options.maxCachedTiles = 20;
+    GeoJSONVT index{ geojson, options };
+    expectCountedMemory(index);
+    const auto built = index.totalMemoryUsage();
+    ASSERT_GT(built.sourceGeometry, 0u);
+    ASSERT_GT(built.sourceFeatures, 0u);
+    ASSERT_GT(built.properties, 0u);
+    ASSERT_GT(built.tileFeatures, 0u);
+    ASSERT_EQ(built.encoded, 0u);
+    ASSERT_GT(built.tables, index.getInternalTiles().size() * detail::TileTable::node_bytes);
+    ASSERT_EQ(index.memoryUsage().at(5).total(), 0u);
+
+    // drill-downs, with transforms, encodes and evictions along the way
+    const auto encode = [](const Tile& tile) { return encodeMVT(tile, "states", 4096); };
+    for (uint8_t z = 0; z < 10; ++z) {
+        const uint32_t z2 = 1u << z;
+        for (uint32_t x = z2 * 9 / 32; x < z2 * 10 / 32 + 1; ++x) {
+            for (uint32_t y = z2 * 11 / 32; y < z2 * 13 / 32 + 1; ++y) {
+                if ((x + y) % 2)
+                    index.getEncodedTile(z, x, y, encode);
+                else
+                    index.getTile(z, x, y);
+            }
+        }
+    }
+    expectCountedMemory(index);
+    ASSERT_GT(index.totalMemoryUsage().encoded, 0u);
+    ASSERT_GT(index.memoryUsage().at(9).total(), 0u);
+
+    index.insert({ mapbox::geometry::point<double>{ -105, 39 } });
+    index.getTiles(0, 7, { { -110, 30 }, { -95, 42 } },
+                   [](uint8_t, uint32_t, uint32_t, const Tile&) {});
+    expectCountedMemory(index);
+
+    // spilled source features only count while they're read back in
+    options.lazyTiles = false;
+    options.spillPath = "test-memory-spill.bin";
+    options.spillResidentBytes = 1;
+    GeoJSONVT spilled{ geojson, options };
+    ASSERT_EQ(spilled.totalMemoryUsage().sourceGeometry, 0u);
+    for (uint32_t x = 36; x < 40; ++x) {
+        spilled.getTile(7, x, 48);
+    }
+    expectCountedMemory(spilled);
+}
+
+TEST(GetTile, Builder) {
+    const auto features = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"))
+                              .get<mapbox::geojson::feature_collection>();
+    Options options;
+    options.indexMaxZoom = 7;
+    options.indexMaxPoints = 200;
+    GeoJSONVT reference{ features, options };
+
+    GeoJSONVT::Builder builder{ options };
+    for (const auto& feature : features) {
+        builder.addFeature(feature.geometry, feature.properties, feature.id);
+    }
+    const auto index = builder.build();
+
+    ASSERT_EQ(index->total, reference.total);
+    for (const auto& pair : reference.getInternalTiles()) {
+        const auto& tile = pair.second;
+        ASSERT_EQ(index->getTile(tile.z, tile.x, tile.y) == tile.tile, true);
+    }
+    ASSERT_EQ(index->getTile(9, 148, 192) == reference.getTile(9, 148, 192), true);
+}
+
+// flattens the coordinates of tile geometry
+template <class T>
+struct CollectPoints {
+    std::vector<double>& out;
+
+    void operator()(const mapbox::geometry::point<T>& p) const {
+        out.push_back(p.x);
+        out.push_back(p.y);
+    }
+    void operator()(const mapbox::geometry::geometry<T>& geometry) const {
+        mapbox::geometry::geometry<T>::visit(geometry, *this);
+    }
+    template <class Container>
+    void operator()(const Container& container) const {
+        for (const auto& element : container) {
+            (*this)(element);
+        }
+    }
+};
+
+template <class T>
+std::vector<double> tilePoints(const BasicTile<T>& tile) {
+    std::vector<double> points;
+    for (const auto& feature : tile.features) {
+        CollectPoints<T>{ points }(feature.geometry);
+    }
+    return points;
+}
+
+TEST(GetTile, CoordinateTypes) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT reference{ geojson };
+
+    Options options;
+    options.extent = 32768;
+    ASSERT_THROW(GeoJSONVT(geojson, options), std::runtime_error);
+
+    // the same tiles on a grid 4 times finer
+    options.extent = 16384;
+    options.buffer = 256;
+    options.tolerance = 12;
+    BasicGeoJSONVT<int32_t> fine{ geojson, options };
+    BasicGeoJSONVT<double> exact{ geojson, options };
+    ASSERT_EQ(fine.total, reference.total);
+    ASSERT_EQ(exact.total, reference.total);
+
+    for (const auto& pair : reference.getInternalTiles()) {
+        const auto& tile = pair.second;
+        const auto& a = fine.getTile(tile.z, tile.x, tile.y);
+        const auto& b = exact.getTile(tile.z, tile.x, tile.y);
+        ASSERT_EQ(a.num_simplified, tile.tile.num_simplified);
+        ASSERT_EQ(b.num_simplified, tile.tile.num_simplified);
+
+        const auto expected = tilePoints(tile.tile);
+        const auto finePoints = tilePoints(a);
+        const auto exactPoints = tilePoints(b);
+        ASSERT_EQ(finePoints.size(), expected.size());
+        ASSERT_EQ(exactPoints.size(), expected.size());
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_LE(std::abs(finePoints[i] - 4 * expected[i]), 2);
+            ASSERT_EQ(finePoints[i], std::round(exactPoints[i]));
+        }
+    }
+
+    ASSERT_EQ(encodeMVT(fine.getTile(7, 37, 48), "states", options.extent).empty(), false);
+
+    // saved indexes only load with the coordinate type they were saved with
+    const std::string path = "test-index-int32.gjvt";
+    fine.save(path);
+    ASSERT_THROW(GeoJSONVT::load(path), std::runtime_error);
+    const auto loaded = BasicGeoJSONVT<int32_t>::load(path);
+    ASSERT_EQ(tilePoints(loaded->getTile(7, 37, 48)), tilePoints(fine.getTile(7, 37, 48)));
+    std::remove(path.c_str());
+}
+
+TEST(GetTile, Updates) {
+    auto features = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"))
+                        .get<mapbox::geojson::feature_collection>();
+    const auto texas = std::find_if(features.begin(), features.end(), [](const auto& feature) {
+        return feature.properties.at("name") == mapbox::geometry::value{ std::string("Texas") };
+    });
+    ASSERT_NE(texas, features.end());
+    const auto feature = *texas;
+    features.erase(texas);
+    auto all = features;
+    all.push_back(feature);
+
+    Options options;
+    options.indexMaxZoom = 4;
+    options.indexMaxPoints = 200;
+    options.updatable = true;
+    GeoJSONVT with{ all, options };
+    GeoJSONVT without{ features, options };
+
+    // tiles around Texas, from both sides of the drilled-down ones
+    const auto compare = [](GeoJSONVT& index, GeoJSONVT& reference) {
+        for (uint8_t z = 0; z < 9; ++z) {
+            const uint32_t z2 = 1u << z;
+            for (uint32_t x = z2 * 0.2; x <= z2 * 0.25; ++x) {
+                for (uint32_t y = z2 * 0.38; y <= z2 * 0.43; ++y) {
+                    expectSameTile(index.getTile(z, x, y), reference.getTile(z, x, y));
+                }
+            }
+        }
+    };
+
+    for (const uint32_t maxCachedTiles : { 0, 20 }) {
+        options.maxCachedTiles = maxCachedTiles;
+        GeoJSONVT index{ features, options };
+        index.getTile(7, 28, 52);
+        index.getTile(8, 57, 105);
+
+        index.insert(feature);
+        compare(index, with);
+
+        ASSERT_TRUE(index.remove(*feature.id));
+        ASSERT_FALSE(index.remove(*feature.id));
+        compare(index, without);
+
+        index.update(feature);
+        compare(index, with);
+    }
+
+    // a point that moves
+    mapbox::geometry::feature<double> point{ mapbox::geometry::point<double>{ -97.7, 30.3 } };
+    point.id = uint64_t(1);
+    GeoJSONVT index{ all, options };
+    index.insert(point);
+    index.getTile(8, 58, 107);
+    point.geometry = mapbox::geometry::point<double>{ -96.8, 32.8 };
+    index.update(point);
+    all.push_back(point);
+    GeoJSONVT moved{ all, options };
+    compare(index, moved);
+}
+
+// just enough of a protobuf reader to take encoded vector tiles apart
+struct PbfMessage {
+    std::string data;
+    std::size_t pos = 0;
+
+    uint64_t varint() {
+        uint64_t result = 0;
+        for (int shift = 0;; shift += 7) {
+            const auto byte = static_cast<uint8_t>(data.at(pos++));
+            result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return result;
+        }
+    }
+
+    // next field as its number and raw value, with varints kept as their value
+    bool next(uint32_t& field, std::string& bytes, uint64_t& value) {
+        if (pos >= data.size())
+            return false;
+        const uint64_t key = varint();
+        field = static_cast<uint32_t>(key >> 3);
+        switch (key & 7) {
+        case 0:
+            value = varint();
+            break;
+        case 1:
+            bytes = data.substr(pos, 8);
+            pos += 8;
+            break;
+        case 2: {
+            const auto size = varint();
+            bytes = data.substr(pos, size);
+            pos += size;
+            break;
+        }
+        default:
+            throw std::runtime_error("unexpected wire type");
+        }
+        return true;
+    }
+
+    std::vector<uint32_t> packed() {
+        std::vector<uint32_t> result;
+        while (pos < data.size()) {
+            result.push_back(static_cast<uint32_t>(varint()));
+        }
+        return result;
+    }
+};
+
+struct DecodedFeature {
+    uint64_t id = 0;
+    uint32_t type = 0;
+    std::vector<uint32_t> tags;
+    std::vector<uint32_t> geometry;
+};
+
+struct DecodedLayer {
+    std::string name;
+    uint64_t version = 0;
+    uint64_t extent = 0;
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    std::vector<DecodedFeature> features;
+};
+
+std::vector<DecodedLayer> decodeMVT(const std::string& data) {
+    std::vector<DecodedLayer> layers;
+    PbfMessage tile{ data };
+    uint32_t field;
+    std::string bytes;
+    uint64_t value;
+    while (tile.next(field, bytes, value)) {
+        EXPECT_EQ(3u, field);
+        DecodedLayer layer;
+        PbfMessage message{ bytes };
+        while (message.next(field, bytes, value)) {
+            if (field == 1)
+                layer.name = bytes;
+            else if (field == 3)
+                layer.keys.push_back(bytes);
+            else if (field == 4)
+                layer.values.push_back(bytes);
+            else if (field == 5)
+                layer.extent = value;
+            else if (field == 15)
+                layer.version = value;
+            else if (field == 2) {
+                DecodedFeature feature;
+                PbfMessage featureMessage{ bytes };
+                while (featureMessage.next(field, bytes, value)) {
+                    if (field == 1)
+                        feature.id = value;
+                    else if (field == 2)
+                        feature.tags = PbfMessage{ bytes }.packed();
+                    else if (field == 3)
+                        feature.type = static_cast<uint32_t>(value);
+                    else if (field == 4)
+                        feature.geometry = PbfMessage{ bytes }.packed();
+                }
+                layer.features.push_back(feature);
+            }
+        }
+        layers.push_back(layer);
+    }
+    return layers;
+}
+
+TEST(Profile, Counters) {
+    resetProfile();
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT index{ geojson };
+    const uint32_t indexed = index.total;
+    (void)indexed;
+    index.getTile(7, 37, 48);
+    index.getTile(7, 37, 48);
+    const auto profile = getProfile();
+
+#ifdef GEOJSONVT_PROFILE
+    ASSERT_EQ(profile[Counter::convert_calls], 1u);
+    ASSERT_EQ(profile[Counter::wrap_calls], 1u);
+    ASSERT_EQ(profile[Counter::tile_calls], index.total);
+    ASSERT_EQ(profile[Counter::drill_downs], 1u);
+    ASSERT_EQ(profile[Counter::drilled_tiles], index.total - indexed);
+    ASSERT_EQ(profile[Counter::cache_hits], 1u);
+    ASSERT_EQ(profile[Counter::cache_misses], 1u);
+    ASSERT_GT(profile[Counter::clip_features_clipped], 0u);
+    // each split makes four children, and only wrap clips whole sets, its three world copies
+    ASSERT_EQ(profile[Counter::split_calls] * 4, profile[Counter::drilled_tiles]);
+    ASSERT_EQ(profile[Counter::clip_x_calls], 3u);
+    ASSERT_EQ(profile[Counter::clip_y_calls], 0u);
+#else
+    for (const auto value : profile.values) {
+        ASSERT_EQ(value, 0u);
+    }
+#endif
+    ASSERT_EQ(std::string(counterName(Counter::cache_hits)), "cache_hits");
+}
+
+// the points of a tile with their kind, multi-points split up, in a fixed order
+std::vector<std::tuple<int16_t, int16_t, std::string>> kindPoints(const Tile& tile) {
+    std::vector<std::tuple<int16_t, int16_t, std::string>> points;
+    for (const auto& feature : tile.features) {
+        const auto kind = feature.properties.at("kind").get<std::string>();
+        mapbox::geometry::for_each_point(feature.geometry, [&](const auto& p) {
+            points.emplace_back(p.x, p.y, kind);
+        });
+    }
+    std::sort(points.begin(), points.end());
+    return points;
+}
+
+TEST(PointIndex, Tiles) {
+    using mapbox::geometry::multi_point;
+    using mapbox::geometry::point;
+
+    // clusters of points, one of them across the antimeridian, and a multi-point
+    mapbox::geometry::feature_collection<double> features;
+    uint64_t state = 1;
+    const auto random = [&] {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (state >> 11) * (1.0 / 9007199254740992.0);
+    };
+    for (int i = 0; i < 3000; ++i) {
+        const double x = i % 3 ? -74 + random() : 179.8 + 0.4 * random();
+        const double y = i % 3 ? 40.5 + random() : -17 + random();
+        mapbox::geometry::feature<double> f{ point<double>{ x, y } };
+        f.properties["kind"] = std::string(i % 2 ? "shop" : "address");
+        if (i % 5 == 0)
+            f.id = mapbox::geometry::identifier{ uint64_t(i) };
+        features.push_back(std::move(f));
+    }
+    mapbox::geometry::feature<double> cloud{ multi_point<double>{
+        { -73.5, 40.7 }, { -73.6, 40.8 }, { 180, -16.5 } } };
+    cloud.properties["kind"] = std::string("cloud");
+    features.push_back(cloud);
+
+    Options options;
+    options.maxZoom = 14;
+    options.indexMaxZoom = 4;
+    GeoJSONVT reference{ features, options };
+
+    PointOptions pointOptions;
+    pointOptions.maxZoom = 14;
+    const PointIndex index{ features, pointOptions };
+    ASSERT_EQ(3003u, index.size());
+
+    // the tiles around some of the points at every zoom, and their neighbours across the buffer
+    std::size_t compared = 0;
+    for (std::size_t i = 0; i < features.size(); i += 97) {
+        const auto projected =
+            detail::project{ 0 }(features[i].geometry.is<point<double>>()
+                                     ? features[i].geometry.get<point<double>>()
+                                     : features[i].geometry.get<multi_point<double>>()[2]);
+        for (uint8_t z = 0; z <= 14; z += 2) {
+            const double z2 = 1u << z;
+            const auto x = static_cast<int32_t>((projected.x - std::floor(projected.x)) * z2);
+            const auto y = static_cast<int32_t>(projected.y * z2);
+            for (int32_t dx = -1; dx <= 1; ++dx) {
+                for (int32_t dy = -1; dy <= 1; ++dy) {
+                    if (y + dy < 0 || y + dy >= z2)
+                        continue;
+                    const auto tile = index.getTile(z, x + dx, y + dy);
+                    ASSERT_EQ(kindPoints(reference.getTile(z, x + dx, y + dy)), kindPoints(tile));
+                    compared += tile.features.size();
+                }
+            }
+        }
+    }
+    ASSERT_GT(compared, 10000u);
+
+    // a tile limit keeps a spread out subset of the points
+    pointOptions.maxPointsPerTile = 50;
+    const PointIndex limited{ features, pointOptions };
+    const auto all = kindPoints(index.getTile(6, 18, 24));
+    const auto some = kindPoints(limited.getTile(6, 18, 24));
+    ASSERT_GT(all.size(), 50u);
+    ASSERT_EQ(50u, some.size());
+    ASSERT_TRUE(std::includes(all.begin(), all.end(), some.begin(), some.end()));
+
+    const mapbox::geometry::line_string<double> line{ { 0, 0 }, { 1, 1 } };
+    ASSERT_THROW(PointIndex({ { line } }), std::runtime_error);
+    pointOptions.maxZoom = 19;
+    ASSERT_THROW(PointIndex(features, pointOptions), std::runtime_error);
+}
+
+TEST(EncodeMVT, Geometry) {
+    using namespace mapbox::geometry;
+
+    const property_map props{ { "name", std::string("a") } };
+    // examples from the vector tile spec, with the polygon also wound the wrong way round and
+    // lines and rings with repeated or degenerate points
+    Tile tile;
+    tile.features.push_back({ point<int16_t>{ 25, 17 }, props, identifier{ uint64_t(7) } });
+    tile.features.push_back({ line_string<int16_t>{ { 2, 2 }, { 2, 10 }, { 2, 10 }, { 10, 10 } },
+                              props });
+    tile.features.push_back(
+        { polygon<int16_t>{ { { 3, 6 }, { 8, 12 }, { 20, 34 }, { 3, 6 } } }, property_map{} });
+    tile.features.push_back(
+        { polygon<int16_t>{ { { 3, 6 }, { 20, 34 }, { 8, 12 }, { 3, 6 } } }, property_map{} });
+    tile.features.push_back({ line_string<int16_t>{ { 5, 5 }, { 5, 5 } }, props });
+    tile.features.push_back(
+        { polygon<int16_t>{ { { 1, 1 }, { 2, 2 }, { 3, 3 }, { 1, 1 } } }, property_map{} });
+
+    const auto layers = decodeMVT(encodeMVT(tile, "test", 4096));
+    ASSERT_EQ(1u, layers.size());
+    const auto& layer = layers[0];
+    ASSERT_EQ("test", layer.name);
+    ASSERT_EQ(2u, layer.version);
+    ASSERT_EQ(4096u, layer.extent);
+    ASSERT_EQ(std::vector<std::string>{ "name" }, layer.keys);
+    ASSERT_EQ(1u, layer.values.size());
+
+    ASSERT_EQ(4u, layer.features.size());
+    ASSERT_EQ(7u, layer.features[0].id);
+    ASSERT_EQ(1u, layer.features[0].type);
+    ASSERT_EQ((std::vector<uint32_t>{ 0, 0 }), layer.features[0].tags);
+    ASSERT_EQ((std::vector<uint32_t>{ 9, 50, 34 }), layer.features[0].geometry);
+
+    ASSERT_EQ(2u, layer.features[1].type);
+    ASSERT_EQ((std::vector<uint32_t>{ 0, 0 }), layer.features[1].tags);
+    ASSERT_EQ((std::vector<uint32_t>{ 9, 4, 4, 18, 0, 16, 16, 0 }), layer.features[1].geometry);
+
+    ASSERT_EQ(3u, layer.features[2].type);
+    ASSERT_TRUE(layer.features[2].tags.empty());
+    ASSERT_EQ((std::vector<uint32_t>{ 9, 6, 12, 18, 10, 12, 24, 44, 15 }),
+              layer.features[2].geometry);
+    ASSERT_EQ((std::vector<uint32_t>{ 9, 16, 24, 18, 24, 44, 33, 55, 15 }),
+              layer.features[3].geometry);
+
+    // layers appended to the same buffer make up one tile
+    std::string buffer;
+    encodeMVT(tile, "first", buffer);
+    encodeMVT(Tile{}, "empty", buffer);
+    encodeMVT(tile, "second", buffer);
+    const auto both = decodeMVT(buffer);
+    ASSERT_EQ(2u, both.size());
+    ASSERT_EQ("second", both[1].name);
+}
+
+TEST(EncodeMVT, WideCoordinates) {
+    using namespace mapbox::geometry;
+    const int32_t min = std::numeric_limits<int32_t>::min();
+    const int32_t max = std::numeric_limits<int32_t>::max();
+
+    // deltas at the ends of the 32-bit range still encode
+    BasicTile<int32_t> tile;
+    tile.features.push_back({ line_string<int32_t>{ { 0, 0 }, { max, min } }, property_map{} });
+    const auto layers = decodeMVT(encodeMVT(tile, "wide"));
+    ASSERT_EQ(1u, layers.size());
+    ASSERT_EQ((std::vector<uint32_t>{ 9, 0, 0, 10, 4294967294u, 4294967295u }),
+              layers[0].features[0].geometry);
+
+    // a delta past them is an error rather than a wrapped coordinate
+    std::string out;
+    tile.features.push_back({ line_string<int32_t>{ { min, 0 }, { max, 0 } }, property_map{} });
+    ASSERT_THROW(encodeMVT(tile, "wide", out), std::runtime_error);
+    ASSERT_TRUE(out.empty());
+}
+
+TEST(EncodeMVT, Tiles) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT index{ geojson };
+
+    const auto& tile = index.getTile(7, 37, 48);
+    const auto layers = decodeMVT(encodeMVT(tile, "states"));
+    ASSERT_EQ(1u, layers.size());
+    ASSERT_EQ(tile.features.size(), layers[0].features.size());
+    for (const auto& feature : layers[0].features) {
+        ASSERT_EQ(3u, feature.type);
+        ASSERT_EQ(4u, feature.tags.size());
+        ASSERT_EQ(15u, feature.geometry.back()); // ClosePath
+    }
+    auto keys = layers[0].keys;
+    std::sort(keys.begin(), keys.end());
+    ASSERT_EQ((std::vector<std::string>{ "density", "name" }), keys);
+}
+
+TEST(EncodeMVT, EncodedTiles) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    const auto encode = [](const Tile& tile) { return encodeMVT(tile, "states"); };
+    GeoJSONVT reference{ geojson };
+    GeoJSONVT index{ geojson };
+
+    const auto& encoded = index.getEncodedTile(7, 37, 48, encode);
+    ASSERT_EQ(encode(reference.getTile(7, 37, 48)), encoded);
+    ASSERT_EQ(&encoded, &index.getEncodedTile(7, 37, 48, encode));
+    expectSameTile(index.getTile(7, 37, 48), reference.getTile(7, 37, 48));
+    ASSERT_EQ("", index.getEncodedTile(7, 0, 0, encode));
+
+    Options options;
+    options.encodedOnly = true;
+    options.lazyTiles = true;
+    GeoJSONVT compact{ geojson, options };
+    ASSERT_EQ(encoded, compact.getEncodedTile(7, 37, 48, encode));
+    ASSERT_EQ(encode(reference.getTile(0, 0, 0)), compact.getEncodedTile(0, 0, 0, encode));
+    const auto& top = compact.getInternalTiles().at(toID(0, 0, 0));
+    ASSERT_TRUE(top.tile.features.empty());
+    ASSERT_THROW(compact.getTile(0, 0, 0), std::runtime_error);
+    expectSameTile(compact.getTile(1, 0, 0), reference.getTile(1, 0, 0));
+    ASSERT_THROW(compact.remove(mapbox::geometry::identifier{ uint64_t(1) }), std::runtime_error);
+}
+
 std::map<std::string, mapbox::geometry::feature_collection<int16_t>>
 genTiles(const std::string& data, uint8_t maxZoom = 0, uint32_t maxPoints = 10000) {
     Options options;